@@ -10,9 +10,18 @@ SOURCES += src/common/main.cxx \
     src/common/CartDetector.cxx \
     src/common/CartDetectorWrapper.cxx \
     src/common/CartProgrammer.cxx \
+    src/common/FlashCache.cxx \
     src/common/FSNode.cxx \
     src/common/Logger.cxx \
+    src/common/LpcIspEmulator.cxx \
+    src/common/SerialPortAsync.cxx \
+    src/common/SerialPortCapture.cxx \
     src/common/SerialPortManager.cxx \
+    src/common/SerialPortReplay.cxx \
+    src/common/SerialPortSimulated.cxx \
+    src/common/TransferPlan.cxx \
+    src/common/Uuencode.cxx \
+    src/common/WireTap.cxx \
     src/common/AboutDialog.cxx
 HEADERS += src/common/HarmonyCartWindow.hxx \
     src/common/QDoubleClickButton.hxx \
@@ -22,12 +31,24 @@ HEADERS += src/common/HarmonyCartWindow.hxx \
     src/common/CartDetector.hxx \
     src/common/CartDetectorWrapper.hxx \
     src/common/CartProgrammer.hxx \
+    src/common/FlashCache.hxx \
     src/common/FSNode.hxx \
+    src/common/IspSession.hxx \
     src/common/Logger.hxx \
+    src/common/LpcIspEmulator.hxx \
     src/common/Progress.hxx \
+    src/common/RxBuffer.hxx \
     src/common/OSystem.hxx \
     src/common/SerialPortManager.hxx \
     src/common/SerialPort.hxx \
+    src/common/SerialPortAsync.hxx \
+    src/common/SerialPortCapture.hxx \
+    src/common/SerialPortReplay.hxx \
+    src/common/SerialPortSimulated.hxx \
+    src/common/SpscRing.hxx \
+    src/common/TransferPlan.hxx \
+    src/common/Uuencode.hxx \
+    src/common/WireTap.hxx \
     src/common/Version.hxx \
     src/common/FindHarmonyThread.hxx \
     src/common/AboutDialog.hxx
@@ -57,8 +78,8 @@ windows {
 unix:!macx {
     DEFINES += BSPF_UNIX
     INCLUDEPATH += src/unix
-    SOURCES += src/unix/FSNodePOSIX.cxx src/unix/SerialPortUNIX.cxx
-    HEADERS += src/unix/FSNodePOSIX.hxx src/unix/SerialPortUNIX.hxx src/unix/OSystemUNIX.hxx
+    SOURCES += src/unix/FSNodePOSIX.cxx src/unix/SerialPortUNIX.cxx src/unix/Termios2.cxx
+    HEADERS += src/unix/FSNodePOSIX.hxx src/unix/SerialPortUNIX.hxx src/unix/Termios2.hxx src/unix/OSystemUNIX.hxx
     TARGET = harmonycart
     target.path = /usr/bin
     docs.path = /usr/share/doc/harmonycart
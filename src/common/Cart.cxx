@@ -370,6 +370,38 @@ cleanup:
   return result;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string Cart::readFlash(SerialPort& port, const string& filename, bool showprogress)
+{
+  std::ofstream out(filename, std::ios::binary);
+  if(!out)
+    return "ERROR: Couldn't open file '" + filename + "'";
+
+  string result = "";
+  try
+  {
+    myProgress.setEnabled(showprogress);
+    result = myProgrammer.readFlash(port, out, 0, myProgress);
+  }
+  catch(const runtime_error& e)
+  {
+    result = e.what();
+  }
+
+  return result;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string Cart::writeTransferPlan(const string& filename) const
+{
+  std::ofstream out(filename);
+  if(!out)
+    return "ERROR: Couldn't open file '" + filename + "'";
+
+  myProgrammer.dumpTransferPlan(out);
+  return "Transfer plan written to '" + filename + "'";
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 ByteBuffer Cart::readFile(const string& filename, size_t& size)
 {
@@ -542,6 +574,97 @@ void Cart::setRetry(uInt32 retry)
   myProgrammer.setRetry(retry);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::setPipelinedTransfer(bool pipelined)
+{
+  myProgrammer.setPipelined(pipelined);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::setEchoOff(bool echoOff)
+{
+  myProgrammer.setEchoOff(echoOff);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::setDifferentialDownload(bool differential)
+{
+  myProgrammer.setDifferential(differential);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::setStagedTransfer(bool staged)
+{
+  myProgrammer.setStaged(staged);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::setBlankCheck(bool blankCheck)
+{
+  myProgrammer.setBlankCheck(blankCheck);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::setFlashCacheEnabled(bool enable)
+{
+  // The cache is always kept, so failed downloads can resume
+  myProgrammer.setFlashCache(&myFlashCache, enable);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::detachFlashCache()
+{
+  myProgrammer.setFlashCache(nullptr, false);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::setMaxBaud(uInt32 baud)
+{
+  myProgrammer.setMaxBaud(baud);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::setPreferredBaud(uInt32 baud)
+{
+  myProgrammer.setPreferredBaud(baud);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 Cart::negotiatedBaud() const
+{
+  return myProgrammer.negotiatedBaud();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::setBootTime(uInt32 millis)
+{
+  myProgrammer.setBootTime(millis);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 Cart::bootTime() const
+{
+  return myProgrammer.bootTime();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 Cart::partID() const
+{
+  return myProgrammer.partID();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool Cart::sessionActive(const SerialPort& port) const
+{
+  return myProgrammer.sessionActive(port);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Cart::endSession()
+{
+  myProgrammer.endSession();
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 uInt8 Cart::ourARHeader[256] = {
   0xac, 0xfa, 0x0f, 0x18, 0x62, 0x00, 0x24, 0x02,
@@ -20,6 +20,7 @@ class SerialPort;
 #include "bspf.hxx"
 #include "Bankswitch.hxx"
 #include "CartProgrammer.hxx"
+#include "FlashCache.hxx"
 #include "Progress.hxx"
 
 /**
@@ -56,12 +57,75 @@ class Cart
                        const string& filename, Bankswitch::Type type,
                        bool verify, bool showprogress, bool continueOnError);
 
+    /**
+      Reads the entire contents of the cart's flash into the given file.
+    */
+    string readFlash(SerialPort& port, const string& filename, bool showprogress);
+
+    /**
+      Writes the transfer plan of the last download (encoded data and the
+      commands sent) to the given file, in readable form.
+    */
+    string writeTransferPlan(const string& filename) const;
+
     /** Set number of write retries before bailing out. */
     void setConnectionAttempts(uInt32 attempt);
 
     /** Set number of write retries before bailing out. */
     void setRetry(uInt32 retry);
 
+    /** Pipeline data lines during download, instead of waiting on each echo. */
+    void setPipelinedTransfer(bool pipelined);
+
+    /** Turn off the bootloader echo during download. */
+    void setEchoOff(bool echoOff);
+
+    /** Only program sectors that differ from the new data. */
+    void setDifferentialDownload(bool differential);
+
+    /** Write several sectors to RAM at once, where RAM is large enough. */
+    void setStagedTransfer(bool staged);
+
+    /** Blank-check sectors before erasing, and skip those already blank. */
+    void setBlankCheck(bool blankCheck);
+
+    /**
+      Skip sectors known to be unchanged since the last download; sectors
+      done by a download that failed are always skipped on the next one.
+    */
+    void setFlashCacheEnabled(bool enable);
+
+    /**
+      Don't use the flash cache at all, not even to resume downloads, so
+      that nothing depends on (or is written to) the settings; for carts
+      that aren't real.
+    */
+    void detachFlashCache();
+
+    /** Highest baud rate to negotiate during download. */
+    void setMaxBaud(uInt32 baud);
+
+    /** Baud rate to try first during negotiation (known to work before). */
+    void setPreferredBaud(uInt32 baud);
+
+    /** Baud rate settled on during the last download (0 for none). */
+    uInt32 negotiatedBaud() const;
+
+    /** Time the bootloader took to answer after a reset before (0 if unknown). */
+    void setBootTime(uInt32 millis);
+
+    /** Time the bootloader took to answer after the last reset. */
+    uInt32 bootTime() const;
+
+    /** Part ID of the detected device (0 for none). */
+    uInt32 partID() const;
+
+    /** Whether the bootloader is still synchronized on the given port. */
+    bool sessionActive(const SerialPort& port) const;
+
+    /** Forget the bootloader session, e.g. when its port is closed. */
+    void endSession();
+
     /**
       On F4 (32K) bankswitching, when the first bank is compressed, the
       cartridge starts in bank 1. This can cause problems with some ROMs.
@@ -96,6 +160,7 @@ class Cart
   private:
     Progress myProgress;
     CartProgrammer myProgrammer;
+    FlashCache myFlashCache;
 
     ostream* myLog{&cout};
     uInt32   myF4FirstCompressionBank{0};
@@ -12,89 +12,45 @@
 // of this file, and for a DISCLAIMER OF ALL WARRANTIES.
 //=========================================================================
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include "FlashCache.hxx"
 #include "SerialPort.hxx"
+#include "Uuencode.hxx"
 #include "CartProgrammer.hxx"
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void CartProgrammer::reset(SerialPort& port)
 {
+  mySession.end();
+
   // Reset and jump to boot loader
   port.controlModemLines(1, 1);
   port.sleepMillis(100);
   port.clearBuffers();
-  port.sleepMillis(100);
   port.controlModemLines(0, 1);
-  // Longer delay is the Reset signal is conected to an external rest controller
-  port.sleepMillis(500);
-  // Clear the RTS line after having reset the micro
-  // Needed for the "GO <Address> <Mode>" ISP command to work
-  port.controlModemLines(0, 0);
+
+  // The ISP line stays asserted until the bootloader answers, which may be
+  // delayed by an external reset controller (see lpc_AwaitBootloader())
+  myBooting = true;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 string CartProgrammer::chipVersion(SerialPort& port)
 {
-  int found, i;
-  int strippedsize;
+  int i;
   char Answer[128], temp[128];
   char *strippedAnswer, *endPtr;
   const char* cmdstr;
 
   static char version[1024] = { 0 };
 
-  for (uInt32 nQuestionMarks = found = 0; !found && nQuestionMarks < myConnectionAttempts; nQuestionMarks++)
-  {
-    port.send("?");
-
-    memset(Answer, 0, sizeof(Answer));
-    strippedsize = static_cast<int>(port.receive(Answer, sizeof(Answer)-1, 1, 100));
-    strippedAnswer = Answer;
-
-    while ((strippedsize > 0) && ((*strippedAnswer == '?') || (*strippedAnswer == 0)))
-    {
-      strippedAnswer++;
-      strippedsize--;
-    }
-
-    lpc_FormatCommand(strippedAnswer, strippedAnswer);
-    if (strcmp(strippedAnswer, "Synchronized\n") == 0)
-      found = 1;
-    else
-      reset(port);
-  } // end for
-
-  if (!found)
-  {
-    strcpy(version, "ERROR: no answer on \'?\'");
-    return version;
-  }
-
-  port.send("Synchronized\r\n");
-  port.receive(Answer, sizeof(Answer) - 1, 2, 1000);
-
-  lpc_FormatCommand(Answer, Answer);
-  if (strcmp(Answer, "Synchronized\nOK\n") != 0)
-  {
-    strcpy(version, "ERROR: No answer on \'Synchronized\'");
-    return version;
-  }
-
-  sprintf(temp, "%s\r\n", myOscillator.c_str());
-  port.send(temp);
-  port.receive(Answer, sizeof(Answer)-1, 2, 1000);
-
-  sprintf(temp, "%s\nOK\n", myOscillator.c_str());
-  lpc_FormatCommand(Answer, Answer);
-  if (strcmp(Answer, temp) != 0)
-  {
-    strcpy(version, "ERROR: No answer on Oscillator-Command");
-    return version;
-  }
-
-  cmdstr = "U 23130\r\n";
-  if (!lpc_SendAndVerify(port, cmdstr, Answer, sizeof Answer))
+  if (string error = lpc_Synchronize(port); !error.empty())
   {
-    sprintf(version, "ERROR: Unlock-Command: %d", (UNLOCK_ERROR + lpc_GetAndReportErrorNumber(Answer)));
+    strcpy(version, error.c_str());
     return version;
   }
 
@@ -164,6 +120,9 @@ string CartProgrammer::chipVersion(SerialPort& port)
   }
   if (myDetectedDevice != 0)
   {
+    // Leave the bootloader listening, for the next operation to pick up
+    mySession.start(port, myDetectedDevice, port.getBaud());
+
     char version[100];
     sprintf(version, "LPC%s, %d kiB FLASH / %d kiB SRAM",
             LPCtypes[myDetectedDevice].Product,
@@ -180,207 +139,139 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
                                 Progress& progress, bool verify,
                                 bool continueOnError)
 {
+  uInt32 ErrorCount = 0;  // errors passed over with continueOnError
   auto handleError = [&](const string& result, bool fatalError = false)
   {
     if(!continueOnError || fatalError)
     {
+      mySession.end();
       progress.finalize();
 
       throw std::runtime_error(result);
     }
     else
+    {
+      ErrorCount++;
       *myLog << result << '\n';
+    }
   };
 
-  char Answer[128], ExpectedAnswer[128], temp[128];
-  char *strippedAnswer{nullptr}, *endPtr{nullptr};
-  int strippedsize{0};
-  int found{0};
+  char Answer[128], ExpectedAnswer[128];
   uInt32 Sector{0};
   uInt32 SectorLength{0};
   uInt32 SectorStart{0}, SectorOffset{0}, SectorChunk{0};
   char tmpString[128];
-  char uuencode_table[64];
   int Line{0};
-  uInt32 tmpStringPos{0};
-  uInt32 BlockOffset{0};
-  uInt32 Block{0};
-  uInt32 Pos{0};
-  uInt32 Id[2];
-  uInt32 Id1Masked{0};
   uInt32 CopyLength{0};
-  int c{0},k{0},i{0};
+  uInt32 SectorsSkipped{0};
   uInt32 ivt_CRC{0};          // CRC over interrupt vector table
   uInt32 block_CRC{0};
-  time_t tStartUpload{0}, tDoneUpload{0};
-  const char* cmdstr{nullptr};
+  std::chrono::steady_clock::time_point tStartUpload, tDoneUpload;
   uInt32 repeat{0};
   ostringstream result;
 
-  // Puffer for data to resend after "RESEND\r\n" Target responce
-  char sendbuf0[128], sendbuf1[128], sendbuf2[128], sendbuf3[128], sendbuf4[128],
-       sendbuf5[128], sendbuf6[128], sendbuf7[128], sendbuf8[128], sendbuf9[128],
-       sendbuf10[128],sendbuf11[128],sendbuf12[128],sendbuf13[128],sendbuf14[128],
-       sendbuf15[128],sendbuf16[128],sendbuf17[128],sendbuf18[128],sendbuf19[128];
-
-  char* sendbuf[20] = {
-    sendbuf0,  sendbuf1,  sendbuf2,  sendbuf3,  sendbuf4,
-    sendbuf5,  sendbuf6,  sendbuf7,  sendbuf8,  sendbuf9,
-    sendbuf10, sendbuf11, sendbuf12, sendbuf13, sendbuf14,
-    sendbuf15, sendbuf16, sendbuf17, sendbuf18, sendbuf19
-  };
-
-  // Make sure the data is aligned to 32-bits, and copy to internal buffer
-  uInt32 BinaryOffset = 0, StartAddress = 0, BinaryLength = size;
-  if(BinaryLength % 4 != 0)
-  {
-    uInt32 newBinaryLength = ((BinaryLength + 3)/4) * 4;
-    *myLog << "Warning:  data not aligned to 32 bits, padded (length was "
-          << BinaryLength << ", now " << newBinaryLength << ")\n";
-    BinaryLength = newBinaryLength;
-  }
-  ByteBuffer binaryContent = make_unique<uInt8[]>(BinaryLength);
-  memcpy(binaryContent.get(), data, size);
-  uInt32 progressStep = 0;
-  progress.initialize("Updating Flash", 0, BinaryLength/45 + 20);
+  // Lines of the current window, to resend after "RESEND\r\n" Target responce;
+  // these point into the transfer plan, so nothing is encoded twice
+  std::string_view sendbuf[MaxWindowLines];
 
-  *myLog << "Synchronizing";
+  // Echoes for a whole window of data lines, when transfer is pipelined
+  char WindowAnswer[MaxWindowLines * 128];
 
-  for (uInt32 nQuestionMarks = found = 0; !found && nQuestionMarks < myConnectionAttempts; nQuestionMarks++)
+  // In pipelined mode, the data lines of a window are sent back-to-back and
+  // their echoes are only collected (and checked) once the window is complete
+  auto receiveWindowEcho = [&](int lines)
   {
-    *myLog << ".";
-    port.send("?");
+    lpc_FormatCommand(port.receiveLines(lines, 5000, sizeof(WindowAnswer)-1), WindowAnswer);
 
-    memset(Answer, 0, sizeof(Answer));
-    strippedsize = static_cast<int>(port.receive(Answer, sizeof(Answer)-1, 1, 100));
-    strippedAnswer = Answer;
-
-    while ((strippedsize > 0) && ((*strippedAnswer == '?') || (*strippedAnswer == 0)))
+    const char* echo = WindowAnswer;
+    for (int i = 0; i < lines; i++)
     {
-      strippedAnswer++;
-      strippedsize--;
+      lpc_FormatCommand(sendbuf[i], tmpString);
+      size_t len = strlen(tmpString);
+      if (strncmp(echo, tmpString, len) != 0)
+        return false;
+      echo += len;
     }
+    return true;
+  };
 
-    tStartUpload = time(NULL);
-
-    lpc_FormatCommand(strippedAnswer, strippedAnswer);
-    if (strcmp(strippedAnswer, "Synchronized\n") == 0)
-      found = 1;
-    else
-      reset(port);
-  } // end for
-
-  if(!found)
-    handleError("ERROR: no answer on '?'", true);
-
-  *myLog << " OK\n";
-
-  port.send("Synchronized\r\n");
-  port.receive(Answer, sizeof(Answer) - 1, 2, 1000);
-
-  lpc_FormatCommand(Answer, Answer);
-  if (strcmp(Answer, "Synchronized\nOK\n") != 0)
-    handleError("ERROR: No answer on 'Synchronized'", true);
-
-  sprintf(temp, "%s\r\n", myOscillator.c_str());
-  port.send(temp);
-  port.receive(Answer, sizeof(Answer)-1, 2, 1000);
-
-  sprintf(temp, "%s\nOK\n", myOscillator.c_str());
-  lpc_FormatCommand(Answer, Answer);
-  if (strcmp(Answer, temp) != 0)
-    handleError("ERROR: No answer on Oscillator-Command", true);
-
-  cmdstr = "U 23130\r\n";
-  if (!lpc_SendAndVerify(port, cmdstr, Answer, sizeof Answer))
-  {
-    result << "ERROR: Unlock-Command: " << lpc_GetAndReportErrorNumber(Answer);
-    handleError(result.str(), true);
-  }
-
-  *myLog << "Read bootcode version: ";
-
-  cmdstr = "K\r\n";
-  port.send(cmdstr);
-  port.receive(Answer, sizeof(Answer)-1, 4, 5000);
-
-  lpc_FormatCommand(cmdstr, temp);
-  lpc_FormatCommand(Answer, Answer);
-  if (strncmp(Answer, temp, strlen(temp)) != 0)
-    handleError("ERROR: no answer on Read Boot Code Version", true);
-
-  if (strncmp(Answer + strlen(temp), "0\n", 2) == 0)
+  // Write data lines of the current window, optionally followed by its
+  // checksum, all with a single call
+  auto sendWindow = [&](int lines, std::string_view checksum = {})
   {
-    strippedAnswer = Answer + strlen(temp) + 2;
-    *myLog << strippedAnswer;
-  }
-  else
-    *myLog << "unknown\n";
-
-  *myLog << "Read part ID: ";
-
-  cmdstr = "J\r\n";
-  port.send(cmdstr);
-  port.receive(Answer, sizeof(Answer)-1, 3, 5000);
-
-  lpc_FormatCommand(cmdstr, temp);
-  lpc_FormatCommand(Answer, Answer);
-  if (strncmp(Answer, temp, strlen(temp)) != 0)
-    handleError("ERROR: no answer on Read Part Id", true);
-
-  strippedAnswer = (strncmp(Answer, "J\n0\n", 4) == 0) ? Answer + 4 : Answer;
-
-  Id[0] = strtoul(strippedAnswer, &endPtr, 10);
-  Id[1] = 0UL;
-  *endPtr = '\0'; /* delete \r\n */
-  for (i = sizeof LPCtypes / sizeof LPCtypes[0] - 1; i > 0 && LPCtypes[i].id != Id[0]; i--)
-    /* nothing */;
-
-  myDetectedDevice = i;
+    std::array<std::string_view, MaxWindowLines + 1> blocks;
+    std::copy_n(sendbuf, lines, blocks.begin());
+    if (!checksum.empty())
+      blocks[lines++] = checksum;
+    port.sendv(std::span(blocks.data(), lines));
+  };
 
-  if (LPCtypes[myDetectedDevice].EvalId2 != 0)
+  // Send the checksum of the current window, and resend the window whenever
+  // the target asks for it; returns the number of retries used.  Data lines
+  // that are still pending (pipelined, without echo) go out with it.
+  auto sendWindowChecksum = [&](int lines, bool pending)
   {
-    /* Read out the second configuration word and run the search again */
-    *endPtr = '\n';
-    endPtr++;
-    if ((endPtr[0] == '\0') || (endPtr[strlen(endPtr)-1] != '\n'))
+    uInt32 repeat = 0;
+    for (; repeat < myRetry; repeat++)
     {
-      /* No or incomplete word 2 */
-      port.receive(endPtr, sizeof(Answer)-(endPtr-Answer)-1, 1, 100);
-    }
-
-    lpc_FormatCommand(endPtr, endPtr);
-    if ((*endPtr == '\0') || (*endPtr == '\n'))
-      handleError("ERROR: incomplete answer on Read Part Id (second configuration word missing)", true);
+      const int len = sprintf(tmpString, "%d\r\n", block_CRC);
+      sendWindow(pending ? lines : 0, std::string_view(tmpString, len));
+      port.receive(Answer, sizeof(Answer)-1, myEchoing ? 2 : 1, 5000);
 
-    Id[1] = strtoul(endPtr, &endPtr, 10);
-    *endPtr = '\0'; /* delete \r\n */
+      if (myEchoing)
+        sprintf(tmpString, "%d\nOK\n", block_CRC);
+      else
+        strcpy(tmpString, "OK\n");
+      lpc_FormatCommand(tmpString, tmpString);
+      lpc_FormatCommand(Answer, Answer);
+      if (strcmp(Answer, tmpString) == 0)
+        break;
 
-    Id1Masked = Id[1] & 0xFF;
+      // The echoes are only drained here; the checksum decides
+      if (!myPipelined)
+      {
+        for (int i = 0; i < lines; i++)
+        {
+          port.send(sendbuf[i]);
+          if (myEchoing)
+            port.receive(Answer, sizeof(Answer)-1, 1, 5000);
+        }
+      }
+      else if (myEchoing)
+      {
+        sendWindow(lines);
+        receiveWindowEcho(lines);
+      }
+      else
+        pending = true;
+    }
+    return repeat;
+  };
 
-    /* now search the table again */
-    for (i = sizeof LPCtypes / sizeof LPCtypes[0] - 1; i > 0 &&
-        (LPCtypes[i].id != Id[0] || LPCtypes[i].id2 != Id1Masked); i--)
-      /* nothing */;
-    myDetectedDevice = i;
-  }
-  if (myDetectedDevice == 0)
-  {
-    *myLog << "unknown";
-  }
-  else
+  // Make sure the data is aligned to 32-bits, and copy to internal buffer
+  uInt32 BinaryOffset = 0, StartAddress = 0, BinaryLength = size;
+  if(BinaryLength % 4 != 0)
   {
-    char version[100];
-    sprintf(version, "LPC%s, %d kiB FLASH / %d kiB SRAM",
-            LPCtypes[myDetectedDevice].Product,
-            LPCtypes[myDetectedDevice].FlashSize,
-            LPCtypes[myDetectedDevice].RAMSize);
-    *myLog << version;
+    uInt32 newBinaryLength = ((BinaryLength + 3)/4) * 4;
+    *myLog << "Warning:  data not aligned to 32 bits, padded (length was "
+          << BinaryLength << ", now " << newBinaryLength << ")\n";
+    BinaryLength = newBinaryLength;
   }
-  if (LPCtypes[myDetectedDevice].EvalId2 != 0)
-    *myLog << " (" << std::hex << Id[0] << "/" << Id[1] << " -> " << Id1Masked << std::dec << ")\n";
-  else
-    *myLog << " (" << std::hex << Id[0] << std::dec << ")\n";
+  // Spot checks send whole blocks of 45 * 4 bytes, so leave room for the
+  // last one to be read past the end of the image
+  ByteBuffer binaryContent = make_unique<uInt8[]>(BinaryLength + 45 * 4);
+  memcpy(binaryContent.get(), data, size);
+  uInt32 progressStep = 0;
+  progress.initialize("Updating Flash", 0, BinaryLength/45 + 20);
+
+  myRecordCommands = false;
+  myWindowLines = MaxWindowLines;
+  myWindowsSent = 5;  // assume a clean link to start with
+  myWindowLinesSent = 5 * MaxWindowLines;
+  myWindowErrors = 0;
+  if (string error = lpc_Connect(port); !error.empty())
+    handleError(error, true);
+  tStartUpload = std::chrono::steady_clock::now();
 
   // Make sure the data can fit in the flash we have available
   if(size > LPCtypes[myDetectedDevice].FlashSize * 1024)
@@ -388,12 +279,6 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
 
   if (true /*!IspEnvironment->DetectOnly*/)
   {
-    // Build up uuencode table
-    uuencode_table[0] = 0x60;           // 0x20 is translated to 0x60 !
-
-    for (int i = 1; i < 64; i++)
-      uuencode_table[i] = (char)(0x20 + i);
-
     if(LPCtypes[myDetectedDevice].ChipVariant == CHIP_VARIANT_LPC2XXX)
     {
       // Patch 0x14, otherwise it is not running and jumps to boot mode
@@ -474,6 +359,63 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
     port.controlXonXoff(0);
   }
 
+  const bool flashTarget = BinaryOffset < lpc_ReturnValueLpcRamStart() ||
+      BinaryOffset >= lpc_ReturnValueLpcRamStart() + (LPCtypes[myDetectedDevice].RAMSize*1024);
+
+  // Flash: use full memory
+  // RAM: Skip first 0x200 bytes, these are used by the download program in LPC21xx
+  const uInt32 planOffset = flashTarget ? 0 : std::min<uInt32>(0x200, BinaryLength);
+  if (myTransferPlan.prepare(binaryContent.get() + planOffset, BinaryLength - planOffset,
+                             partID()))
+    *myLog << "Reusing data encoded for the previous download\n";
+  myRecordCommands = true;
+
+  // Sectors the flash cache says already hold the new data aren't sent at all
+  BoolArray SectorCached(LPCtypes[myDetectedDevice].FlashSectors, false);
+  const bool useFlashCache = myFlashCache != nullptr && flashTarget;
+  if (useFlashCache)
+  {
+    lpc_CheckFlashCache(port, binaryContent.get(), BinaryLength, SectorCached);
+
+    // Whatever is about to be written is unknown until it's programmed, and
+    // the entry only describes a complete image once the download completes
+    uInt32 start = 0;
+    for (uInt32 s = 0; s < SectorCached.size() && start < BinaryLength;
+         start += LPCtypes[myDetectedDevice].SectorTable[s], ++s)
+      if (!SectorCached[s])
+        myFlashCache->setHash(s, "");
+    myFlashCache->setComplete(false);
+    myFlashCache->save();
+  }
+
+  // Sectors that are already blank don't need to be erased.  Sector 0 is
+  // left out, since its first 64 bytes are remapped to the boot block and
+  // never read as blank.
+  BoolArray SectorBlank(LPCtypes[myDetectedDevice].FlashSectors, false);
+  if (myBlankCheck && flashTarget)
+  {
+    uInt32 last = 0, start = 0;
+    while (last < SectorBlank.size() && start + LPCtypes[myDetectedDevice].SectorTable[last] < BinaryLength)
+      start += LPCtypes[myDetectedDevice].SectorTable[last++];
+    last = std::min<uInt32>(last, SectorBlank.size() - 1);
+
+    // Cached sectors hold data, so only check the runs between them
+    for (uInt32 first = 1; first <= last; ++first)
+    {
+      if (SectorCached[first])
+        continue;
+
+      uInt32 runEnd = first;
+      while (runEnd < last && !SectorCached[runEnd + 1])
+        runEnd++;
+      lpc_FindBlankSectors(port, first, runEnd, SectorBlank);
+      first = runEnd;
+    }
+
+    if (uInt32 blank = std::count(SectorBlank.begin(), SectorBlank.end(), true); blank > 0)
+      *myLog << blank << " sector(s) already blank, not erasing them\n";
+  }
+
   // Start with sector 1 and go upward... Sector 0 containing the interrupt vectors
   // will be loaded last, since it contains a checksum and device will re-enter
   // bootloader mode as long as this checksum is invalid.
@@ -489,98 +431,303 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
     Sector = 1;
   }
 
-  // Erasing sector 0 first
-  *myLog << "Erasing sector 0 first, to invalidate checksum. ";
-
-  if (auto type = LPCtypes[myDetectedDevice].ChipVariant;
-      type == CHIP_VARIANT_LPC43XX || type == CHIP_VARIANT_LPC18XX)
+  // In differential mode, a sector that fits in RAM is only erased once
+  // it's known to differ from the new data
+  auto defersErase = [&](uInt32 sector, uInt32 length)
   {
-    // TODO: Quick and dirty hack to address bank 0
-    sprintf(tmpString, "P %d %d 0\r\n", 0, 0);
-  }
-  else
-    sprintf(tmpString, "P %d %d\r\n", 0, 0);
+    return myDifferential && sector != 0 && flashTarget &&
+           length <= LPCtypes[myDetectedDevice].MaxCopySize;
+  };
 
-  if (!lpc_SendAndVerify(port, tmpString, Answer, sizeof Answer))
+  // Prepare a range of sectors for writing, and erase them
+  auto prepareAndErase = [&](uInt32 first, uInt32 last)
   {
-    result << "ERROR: Wrong answer on Prepare-Command " << lpc_GetAndReportErrorNumber(Answer);
-    handleError(result.str());
-  }
+    if (auto type = LPCtypes[myDetectedDevice].ChipVariant;
+      type == CHIP_VARIANT_LPC43XX || type == CHIP_VARIANT_LPC18XX)
+    {
+      // TODO: Quick and dirty hack to address bank 0
+      sprintf(tmpString, "P %d %d 0\r\n", first, last);
+    }
+    else
+      sprintf(tmpString, "P %d %d\r\n", first, last);
 
-  if (auto type = LPCtypes[myDetectedDevice].ChipVariant;
+    if (!lpc_SendAndVerify(port, tmpString, Answer, sizeof Answer))
+    {
+      result << "ERROR: Wrong answer on Prepare-Command (1) (Sector " << first << ") "
+             << lpc_GetAndReportErrorNumber(Answer);
+      handleError(result.str());
+    }
+
+    *myLog << "." << std::flush;
+
+    if (auto type = LPCtypes[myDetectedDevice].ChipVariant;
       type == CHIP_VARIANT_LPC43XX || type == CHIP_VARIANT_LPC18XX)
+    {
+      // TODO: Quick and dirty hack to address bank 0
+      sprintf(tmpString, "E %d %d 0\r\n", first, last);
+    }
+    else
+      sprintf(tmpString, "E %d %d\r\n", first, last);
+
+    if (!lpc_SendAndVerify(port, tmpString, Answer, sizeof Answer))
+    {
+      result << "ERROR: Wrong answer on Erase-Command (Sector " << first << ") "
+             << lpc_GetAndReportErrorNumber(Answer);
+      handleError(result.str());
+    }
+
+    *myLog << "." << std::flush;
+  };
+
+  // Work out which sectors the image needs erased, so they can be erased
+  // with as few range commands as possible.  Sector 0 is always part of the
+  // first range, so the checksum is still invalidated first.
+  BoolArray EraseUpFront(LPCtypes[myDetectedDevice].FlashSectors, false);
+  if (flashTarget)  // Skip Erase when running from RAM
   {
-    // TODO: Quick and dirty hack to address bank 0
-    sprintf(tmpString, "E %d %d 0\r\n", 0, 0);
+    uInt32 start = 0;
+    for (uInt32 s = 0; s < EraseUpFront.size() && start < BinaryLength;
+         start += LPCtypes[myDetectedDevice].SectorTable[s], ++s)
+    {
+      const uInt32 length = std::min(LPCtypes[myDetectedDevice].SectorTable[s], BinaryLength - start);
+      EraseUpFront[s] = s == 0 ||
+          (!SectorCached[s] && !SectorBlank[s] && !defersErase(s, length));
+    }
   }
-  else
-    sprintf(tmpString, "E %d %d\r\n", 0, 0);
 
-  if (!lpc_SendAndVerify(port, tmpString, Answer, sizeof Answer))
+  for (uInt32 first = 0; first < EraseUpFront.size(); ++first)
   {
-    result << "ERROR: Wrong answer on Erase-Command " << lpc_GetAndReportErrorNumber(Answer);
-    handleError(result.str());
-  }
+    if (!EraseUpFront[first])
+      continue;
 
-  *myLog << "OK \n";
+    uInt32 last = first;
+    while (last + 1 < EraseUpFront.size() && EraseUpFront[last + 1])
+      last++;
 
-  // OK, the main loop where we start writing to the cart
-  while (1)
-  {
-    if (Sector >= LPCtypes[myDetectedDevice].FlashSectors)
-      handleError("ERROR: Program too large; running out of Flash sectors", true);
+    if (first == last)
+      *myLog << "Erasing sector " << first;
+    else
+      *myLog << "Erasing sectors " << first << "-" << last;
+    *myLog << (first == 0 ? ", sector 0 first to invalidate checksum. " : ". ");
+    prepareAndErase(first, last);
+    *myLog << "OK \n";
 
-    *myLog << "Sector " << Sector << std::flush;
-    progress.updateText("Downloading sector " + QString::number(Sector) + " ...                  ");
+    first = last;
+  }
 
-    if ( BinaryOffset < lpc_ReturnValueLpcRamStart()  // Skip Erase when running from RAM
-         || (BinaryOffset >= lpc_ReturnValueLpcRamStart() + (LPCtypes[myDetectedDevice].RAMSize*1024)))
-    {
-      if (auto type = LPCtypes[myDetectedDevice].ChipVariant;
-        type == CHIP_VARIANT_LPC43XX || type == CHIP_VARIANT_LPC18XX)
-      {
-        // TODO: Quick and dirty hack to address bank 0
-        sprintf(tmpString, "P %d %d 0\r\n", Sector, Sector);
-      }
-      else
-        sprintf(tmpString, "P %d %d\r\n", Sector, Sector);
+  // Write the given part of the image to RAM (at the RAM base), using a
+  // single 'W' command unless the window has been made smaller than the
+  // bootloader's own; Length is already rounded up as the part requires
+  auto transferToRam = [&](uInt32 ImageStart, uInt32 Length)
+  {
+    const auto type = LPCtypes[myDetectedDevice].ChipVariant;
+    const bool uuencoded =
+        type == CHIP_VARIANT_LPC2XXX || type == CHIP_VARIANT_LPC17XX || type == CHIP_VARIANT_LPC13XX ||
+        type == CHIP_VARIANT_LPC11XX || type == CHIP_VARIANT_LPC18XX || type == CHIP_VARIANT_LPC43XX;
 
+    uInt32 Chunk = 0;
+    for (uInt32 Offset = 0; Offset < Length; Offset += Chunk)
+    {
+      // The bootloader wants a checksum after every 20 lines of a 'W'
+      // command, so a smaller window takes a 'W' command of its own; the
+      // window stays the same for the whole command, even when it's
+      // adapted on the way
+      const int WindowLines = static_cast<int>(myWindowLines);
+      Chunk = Length - Offset;
+      if (uuencoded && WindowLines < MaxWindowLines)
+        Chunk = std::min<uInt32>(Chunk, WindowLines * 45);
+
+      sprintf(tmpString, "W %d %d\r\n", lpc_ReturnValueLpcRamBase() + Offset, Chunk);
       if (!lpc_SendAndVerify(port, tmpString, Answer, sizeof Answer))
       {
-        result << "ERROR: Wrong answer on Prepare-Command (1) (Sector " << Sector << ") "
-               << lpc_GetAndReportErrorNumber(Answer);
+        result << "ERROR: Wrong answer on Write-Command " << lpc_GetAndReportErrorNumber(Answer);
         handleError(result.str());
       }
 
-      *myLog << "." << std::flush;
+      if (Offset == 0)
+        *myLog << "." << std::flush;
 
-      if (Sector != 0) // Sector 0 already erased
+      if (uuencoded)
       {
-        if (auto type = LPCtypes[myDetectedDevice].ChipVariant;
-          type == CHIP_VARIANT_LPC43XX || type == CHIP_VARIANT_LPC18XX)
-        {
-          // TODO: Quick and dirty hack to address bank 0
-          sprintf(tmpString, "E %d %d 0\r\n", Sector, Sector);
-        }
-        else
-          sprintf(tmpString, "E %d %d\r\n", Sector, Sector);
+        block_CRC = 0;
+        Line = 0;
 
-        if (!lpc_SendAndVerify(port, tmpString, Answer, sizeof Answer))
+        // Transfer blocks of 45 * 4 bytes to RAM, as encoded in the plan
+        const TransferPlan::Transfer& transfer = myTransferPlan.transfer(ImageStart, Length);
+        for (uInt32 i = Offset / 45; i < (Offset + Chunk) / 45; i++)
         {
-          result << "ERROR: Wrong answer on Erase-Command (Sector " << Sector << ") "
-                 << lpc_GetAndReportErrorNumber(Answer);
-          handleError(result.str());
-        }
+          *myLog << '.';
 
-        *myLog << "." << std::flush;
+          // Inform the calling application about having written another chuck of data
+          if(!progress.updateValue(++progressStep))
+            handleError("Cancelled download", true);
+
+          sendbuf[Line] = transfer.text(i);
+          block_CRC += transfer.sum(i);
+
+          // When pipelined, lines are only sent once the window is complete
+          if (!myPipelined)
+          {
+            port.send(sendbuf[Line]);
+
+            // receive only for debug purposes
+            if (myEchoing)
+            {
+              port.receive(Answer, sizeof(Answer)-1, 1, 5000);
+              lpc_FormatCommand(sendbuf[Line], tmpString);
+              lpc_FormatCommand(Answer, Answer);
+              if (strncmp(Answer, tmpString, strlen(tmpString)) != 0)
+                handleError("Error on writing data (1)");
+            }
+          }
+
+          Line++;
+          if (Line == WindowLines)
+          {
+            *myLog << std::flush;
+            if (myPipelined && myEchoing)
+            {
+              sendWindow(Line);
+              if (!receiveWindowEcho(Line))
+                handleError("Error on writing data (1)");
+            }
+
+            repeat = sendWindowChecksum(Line, myPipelined && !myEchoing);
+            if (repeat >= myRetry)
+            {
+              result << "ERROR: writing block_CRC (1), retries = " << repeat;
+              handleError(result.str(), true);
+            }
+            if (myRecordCommands)
+              myTransferPlan.addWindowEnd(ImageStart, Length, i);
+            lpc_AdaptWindow(Line, repeat);
+
+            Line = 0;
+            block_CRC = 0;
+          }
+        }
+
+        if (Line != 0)
+        {
+          if (myPipelined && myEchoing)
+          {
+            sendWindow(Line);
+            if (!receiveWindowEcho(Line))
+              handleError("Error on writing data (2)");
+          }
+
+          repeat = sendWindowChecksum(Line, myPipelined && !myEchoing);
+          if (repeat >= myRetry)
+          {
+            result << "ERROR: writing block_CRC (3), retries = " << repeat;
+            handleError(result.str(), true);
+          }
+          if (myRecordCommands)
+            myTransferPlan.addWindowEnd(ImageStart, Length, (Offset + Chunk) / 45 - 1);
+          lpc_AdaptWindow(Line, repeat);
+        }
+      }
+      else if (type == CHIP_VARIANT_LPC8XX)
+      {
+        uInt8 BigAnswer[4096];
+        uInt32 CopyLengthPartialOffset = 0;
+        uInt32 CopyLengthPartialRemainingBytes;
+
+        while (CopyLengthPartialOffset < Length)
+        {
+          CopyLengthPartialRemainingBytes = Length - CopyLengthPartialOffset;
+          if (CopyLengthPartialRemainingBytes > 256)
+          {
+            // There seems to be an error in LPC812:
+            // When too much bytes are written at high speed,
+            // bytes get lost
+            // Workaround: Use smaller blocks
+            CopyLengthPartialRemainingBytes = 256;
+          }
+
+          const void* data = binaryContent.get() + (ImageStart + CopyLengthPartialOffset);
+          port.send(data, CopyLengthPartialRemainingBytes);
+
+          if (port.receiveCompleteBlock(&BigAnswer, CopyLengthPartialRemainingBytes, 10000) != 0)
+            handleError("ERROR_WRITE_DATA");
+
+          if(std::memcmp(binaryContent.get() + (ImageStart + CopyLengthPartialOffset), BigAnswer, CopyLengthPartialRemainingBytes))
+            handleError("ERROR_WRITE_DATA");
+
+          CopyLengthPartialOffset += CopyLengthPartialRemainingBytes;
+        }
       }
     }
+  };
+
+  // RAM available for staging several sectors at once; the top of RAM
+  // holds the bootloader's stack and its flash programming workspace
+  const uInt32 RamAvailable = LPCtypes[myDetectedDevice].RAMSize*1024 -
+      (lpc_ReturnValueLpcRamBase() - lpc_ReturnValueLpcRamStart());
+  const uInt32 StagingSize = RamAvailable > 288 ? RamAvailable - 288 : 0;
+  uInt32 StagedFirst = 1, StagedLast = 0, StagedStart = 0;  // none staged yet
+  uInt32 RamAddress = lpc_ReturnValueLpcRamBase();
+
+  // OK, the main loop where we start writing to the cart
+  while (1)
+  {
+    if (Sector >= LPCtypes[myDetectedDevice].FlashSectors)
+      handleError("ERROR: Program too large; running out of Flash sectors", true);
+
+    *myLog << "Sector " << Sector << std::flush;
+    progress.updateText("Downloading sector " + QString::number(Sector) + " ...                  ");
 
     SectorLength = LPCtypes[myDetectedDevice].SectorTable[Sector];
     if (SectorLength > BinaryLength - SectorStart)
       SectorLength = BinaryLength - SectorStart;
+    const uInt32 SectorErrors = ErrorCount;
+
+    // Sectors not erased up front are either cached, blank or deferred
+    const bool deferErase = !SectorCached[Sector] && !SectorBlank[Sector] &&
+                            defersErase(Sector, SectorLength);
+
+    if (SectorCached[Sector])
+    {
+      *myLog << " unchanged since last download, skipping programming." << std::flush;
+      SectorsSkipped++;
+    }
+    else if (myStaged && flashTarget && Sector != 0 &&
+             (Sector < StagedFirst || Sector > StagedLast))
+    {
+      // Pack as many of the following sectors into RAM as will fit, so
+      // they all go out with one 'W' command and are then copied to flash
+      // one after the other; runs end at cached, blank or oversized sectors
+      uInt32 last = Sector, stagedSize = 0, start = SectorStart;
+      for (uInt32 s = Sector; s < LPCtypes[myDetectedDevice].FlashSectors && start < BinaryLength;
+           start += LPCtypes[myDetectedDevice].SectorTable[s], ++s)
+      {
+        const uInt32 size = LPCtypes[myDetectedDevice].SectorTable[s];
+        const uInt32 length = std::min(size, BinaryLength - start);
+        if (SectorCached[s] || size > LPCtypes[myDetectedDevice].MaxCopySize ||
+            stagedSize + size + 45 * 4 > StagingSize ||
+            std::all_of(&binaryContent[start], &binaryContent[start + length],
+                        [](uInt8 b) { return b == 0xFF; }))
+          break;
+
+        last = s;
+        stagedSize += size;
+      }
+
+      if (last > Sector)
+      {
+        uInt32 length = std::min(stagedSize, BinaryLength - SectorStart);
+        if ((length % (45 * 4)) != 0)
+          length += ((45 * 4) - (length % (45 * 4)));
+
+        *myLog << " (staging sectors " << Sector << "-" << last << " in RAM)" << std::flush;
+        transferToRam(SectorStart, length);
+        StagedFirst = Sector;
+        StagedLast  = last;
+        StagedStart = SectorStart;
+      }
+    }
 
-    for (SectorOffset = 0; SectorOffset < SectorLength; SectorOffset += SectorChunk)
+    for (SectorOffset = 0; !SectorCached[Sector] && SectorOffset < SectorLength; SectorOffset += SectorChunk)
     {
       // Check if we are to write only 0xFFs - it would be just a waste of time..
       if (SectorOffset == 0)
@@ -591,6 +738,8 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
 
         if (SectorOffset == SectorLength) // all data contents were 0xFFs
         {
+          if (deferErase)
+            prepareAndErase(Sector, Sector);
           *myLog << "Whole sector contents is 0xFFs, skipping programming." << std::flush;
           break;
         }
@@ -622,168 +771,25 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
           CopyLength += ((45 * 4) - (CopyLength % (45 * 4)));
       }
 
-      sprintf(tmpString, "W %d %d\r\n", lpc_ReturnValueLpcRamBase(), CopyLength);
-      if (!lpc_SendAndVerify(port, tmpString, Answer, sizeof Answer))
+      if (Sector >= StagedFirst && Sector <= StagedLast)
+        RamAddress = lpc_ReturnValueLpcRamBase() + (SectorStart - StagedStart);
+      else
       {
-        result << "ERROR: Wrong answer on Write-Command " << lpc_GetAndReportErrorNumber(Answer);
-        handleError(result.str());
+        transferToRam(SectorStart + SectorOffset, CopyLength);
+        RamAddress = lpc_ReturnValueLpcRamBase();
       }
 
-      *myLog << "." << std::flush;
-
-      if(auto type = LPCtypes[myDetectedDevice].ChipVariant;
-          type == CHIP_VARIANT_LPC2XXX || type == CHIP_VARIANT_LPC17XX || type == CHIP_VARIANT_LPC13XX ||
-          type == CHIP_VARIANT_LPC11XX || type == CHIP_VARIANT_LPC18XX || type == CHIP_VARIANT_LPC43XX)
-      {
-        block_CRC = 0;
-        Line = 0;
-
-        // Transfer blocks of 45 * 4 bytes to RAM
-        for (Pos = SectorStart + SectorOffset; (Pos < SectorStart + SectorOffset + CopyLength) && (Pos < BinaryLength); Pos += (45 * 4))
-        {
-          for (Block = 0; Block < 4; Block++)  // Each block 45 bytes
-          {
-            *myLog << "." << std::flush;
-
-            // Inform the calling application about having written another chuck of data
-            if(!progress.updateValue(++progressStep))
-              handleError("Cancelled download", true);
-
-            // Uuencode one 45 byte block
-            tmpStringPos = 0;
-
-            sendbuf[Line][tmpStringPos++] = (char)(' ' + 45);    // Encode Length of block
-
-            for (BlockOffset = 0; BlockOffset < 45; BlockOffset++)
-            {
-              if (BinaryOffset < lpc_ReturnValueLpcRamStart() ||
-                 (BinaryOffset >= lpc_ReturnValueLpcRamStart()+(LPCtypes[myDetectedDevice].RAMSize*1024)))
-              { // Flash: use full memory
-                c = binaryContent[Pos + Block * 45 + BlockOffset];
-              }
-              else
-              { // RAM: Skip first 0x200 bytes, these are used by the download program in LPC21xx
-                c = binaryContent[Pos + Block * 45 + BlockOffset + 0x200];
-              }
-
-              block_CRC += c;
-              k = (k << 8) + (c & 255);
-
-              if ((BlockOffset % 3) == 2)   // Collecting always 3 Bytes, then do processing in 4 Bytes
-              {
-                sendbuf[Line][tmpStringPos++] = uuencode_table[(k >> 18) & 63];
-                sendbuf[Line][tmpStringPos++] = uuencode_table[(k >> 12) & 63];
-                sendbuf[Line][tmpStringPos++] = uuencode_table[(k >>  6) & 63];
-                sendbuf[Line][tmpStringPos++] = uuencode_table[ k        & 63];
-              }
-            }
-            sendbuf[Line][tmpStringPos++] = '\r';
-            sendbuf[Line][tmpStringPos++] = '\n';
-            sendbuf[Line][tmpStringPos++] = 0;
-            port.send(sendbuf[Line]);
-
-            // receive only for debug purposes
-            port.receive(Answer, sizeof(Answer)-1, 1, 5000);
-            lpc_FormatCommand(sendbuf[Line], tmpString);
-            lpc_FormatCommand(Answer, Answer);
-            if (strncmp(Answer, tmpString, strlen(tmpString)) != 0)
-              handleError("Error on writing data (1)");
-
-            Line++;
-            if (Line == 20)
-            {
-              for (repeat = 0; repeat < myRetry; repeat++)
-              {
-                sprintf(tmpString, "%d\r\n", block_CRC);
-                port.send(tmpString);
-                port.receive(Answer, sizeof(Answer)-1, 2, 5000);
-
-                sprintf(tmpString, "%d\nOK\n", block_CRC);
-                lpc_FormatCommand(tmpString, tmpString);
-                lpc_FormatCommand(Answer, Answer);
-                if (strcmp(Answer, tmpString) != 0)
-                {
-                  for (i = 0; i < Line; i++)
-                  {
-                    port.send(sendbuf[i]);
-                    port.receive(Answer, sizeof(Answer)-1, 1, 5000);
-                  }
-                }
-                else
-                  break;
-              }
-
-              if (repeat >= myRetry)
-              {
-                result << "ERROR: writing block_CRC (1), retries = " << repeat;
-                handleError(result.str(), true);
-              }
-
-              Line = 0;
-              block_CRC = 0;
-            }
-          }
-        }
-
-        if (Line != 0)
-        {
-          for (repeat = 0; repeat < myRetry; repeat++)
-          {
-            sprintf(tmpString, "%d\r\n", block_CRC);
-            port.send(tmpString);
-            port.receive(Answer, sizeof(Answer)-1, 2, 5000);
-
-            sprintf(tmpString, "%d\nOK\n", block_CRC);
-            lpc_FormatCommand(tmpString, tmpString);
-            lpc_FormatCommand(Answer, Answer);
-            if (strcmp(Answer, tmpString) != 0)
-            {
-              for (i = 0; i < Line; i++)
-              {
-                port.send(sendbuf[i]);
-                port.receive(Answer, sizeof(Answer)-1, 1, 5000);
-              }
-            }
-            else
-              break;
-          }
-
-          if (repeat >= myRetry)
-          {
-            result << "ERROR: writing block_CRC (3), retries = " << repeat;
-            handleError(result.str(), true);
-          }
-        }
-      }
-      else if (LPCtypes[myDetectedDevice].ChipVariant == CHIP_VARIANT_LPC8XX)
+      if (deferErase)
       {
-        uInt8 BigAnswer[4096];
-        uInt32 CopyLengthPartialOffset = 0;
-        uInt32 CopyLengthPartialRemainingBytes;
-
-        while (CopyLengthPartialOffset < CopyLength)
+        // The new data is in RAM now, so compare it with what's in flash
+        // before erasing anything
+        if (lpc_Compare(port, BinaryOffset + SectorStart, RamAddress, SectorLength))
         {
-          CopyLengthPartialRemainingBytes = CopyLength - CopyLengthPartialOffset;
-          if (CopyLengthPartialRemainingBytes > 256)
-          {
-            // There seems to be an error in LPC812:
-            // When too much bytes are written at high speed,
-            // bytes get lost
-            // Workaround: Use smaller blocks
-            CopyLengthPartialRemainingBytes = 256;
-          }
-
-          const void* data = binaryContent.get() + (SectorStart + SectorOffset + CopyLengthPartialOffset);
-          port.send(data, CopyLengthPartialRemainingBytes);
-
-          if (port.receiveCompleteBlock(&BigAnswer, CopyLengthPartialRemainingBytes, 10000) != 0)
-            handleError("ERROR_WRITE_DATA");
-
-          if(std::memcmp(binaryContent.get() + (SectorStart + SectorOffset + CopyLengthPartialOffset), BigAnswer, CopyLengthPartialRemainingBytes))
-            handleError("ERROR_WRITE_DATA");
-
-          CopyLengthPartialOffset += CopyLengthPartialRemainingBytes;
+          *myLog << " unchanged, skipping programming." << std::flush;
+          SectorsSkipped++;
+          break;
         }
+        prepareAndErase(Sector, Sector);
       }
 
       if (BinaryOffset < lpc_ReturnValueLpcRamStart() ||
@@ -822,7 +828,7 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
           CopyLength = LPCtypes[myDetectedDevice].MaxCopySize;
 
         sprintf(tmpString, "C %d %d %d\r\n", BinaryOffset + SectorStart + SectorOffset,
-                lpc_ReturnValueLpcRamBase(), CopyLength);
+                RamAddress, CopyLength);
         if (!lpc_SendAndVerify(port, tmpString, Answer, sizeof Answer))
         {
           result << "ERROR: Wrong answer on Copy-Command " << lpc_GetAndReportErrorNumber(Answer);
@@ -835,11 +841,11 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
           // Because first 64 bytes are re-mapped to flash boot sector,
           // and the compare result may not be correct.
           if (SectorStart + SectorOffset<64)
-            sprintf(tmpString, "M %d %d %d\r\n", 64, lpc_ReturnValueLpcRamBase() +
+            sprintf(tmpString, "M %d %d %d\r\n", 64, RamAddress +
                 (64 - SectorStart - SectorOffset), CopyLength-(64 - SectorStart - SectorOffset));
           else
             sprintf(tmpString, "M %d %d %d\r\n", SectorStart + SectorOffset,
-                lpc_ReturnValueLpcRamBase(), CopyLength);
+                RamAddress, CopyLength);
 
           if (!lpc_SendAndVerify(port, tmpString, Answer, sizeof Answer))
           {
@@ -850,6 +856,14 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
       }
     }
 
+    // Record each sector as soon as it's known to hold the new data, so a
+    // download that fails or is cancelled later on resumes from here
+    if (useFlashCache && !SectorCached[Sector] && ErrorCount == SectorErrors)
+    {
+      myFlashCache->setHash(Sector, FlashCache::hash(binaryContent.get() + SectorStart, SectorLength));
+      myFlashCache->save();
+    }
+
     *myLog << "\n" << std::flush;
 
     if ((SectorStart + SectorLength) >= BinaryLength && Sector!=0)
@@ -869,11 +883,24 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
   }
 
   ostringstream returnVal;
-  tDoneUpload = time(NULL);
+  if (myDifferential || useFlashCache)
+    *myLog << SectorsSkipped << " sector(s) already up to date\n";
+
+  // Sectors left out after errors still need programming next time
+  if (useFlashCache && ErrorCount == 0)
+  {
+    myFlashCache->setComplete(true);
+    myFlashCache->save();
+  }
+
+  tDoneUpload = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>(tDoneUpload - tStartUpload).count();
   if (verify)
-    returnVal << "Download Finished and Verified correct... taking " << int(tDoneUpload - tStartUpload) << " seconds";
+    returnVal << "Download Finished and Verified correct... taking "
+              << std::fixed << std::setprecision(2) << seconds << " seconds";
   else
-    returnVal << "Download Finished... taking " << int(tDoneUpload - tStartUpload) << " seconds";
+    returnVal << "Download Finished... taking "
+              << std::fixed << std::setprecision(2) << seconds << " seconds";
 
   // For LPC18xx set boot bank to 0
   if (auto type = LPCtypes[myDetectedDevice].ChipVariant;
@@ -901,11 +928,14 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
     else
       handleError("Internal Error", true);
 
+    if (myRecordCommands)
+      myTransferPlan.addCommand(tmpString);
+    mySession.end();  // the bootloader is done once the new code runs
     port.send(tmpString);  //goto 0 : run this fresh new downloaded code code
     if (BinaryOffset < lpc_ReturnValueLpcRamStart() ||
         BinaryOffset >= lpc_ReturnValueLpcRamStart() + (LPCtypes[myDetectedDevice].RAMSize*1024))
     { // Skip response on G command - show response on Terminal instead
-      size_t realsize = port.receive(Answer, sizeof(Answer)-1, 2, 5000);
+      size_t realsize = port.receive(Answer, sizeof(Answer)-1, myEchoing ? 2 : 1, 5000);
       /* the reply string is frequently terminated with a -1 (EOF) because the
        * connection gets broken; zero-terminate the string ourselves
        */
@@ -916,7 +946,9 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
       /* Better to check only the first 9 chars instead of complete receive buffer,
        * because the answer can contain the output by the started programm
        */
-      if(type == CHIP_VARIANT_LPC2XXX)
+      if(!myEchoing)
+        sprintf(ExpectedAnswer, "0");
+      else if(type == CHIP_VARIANT_LPC2XXX)
         sprintf(ExpectedAnswer, "G %d A\n0", StartAddress);
       else if(type == CHIP_VARIANT_LPC43XX || type == CHIP_VARIANT_LPC18XX || type == CHIP_VARIANT_LPC17XX ||
               type == CHIP_VARIANT_LPC13XX || type == CHIP_VARIANT_LPC11XX)
@@ -937,6 +969,7 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
     *myLog << std::flush;
   }
 
+  myRecordCommands = false;
   progress.finalize();
 
   *myLog << returnVal.str() << '\n';
@@ -944,111 +977,917 @@ string CartProgrammer::download(SerialPort& port, uInt8* data, uInt32 size,
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-int CartProgrammer::lpc_SendAndVerify(SerialPort& port, const char* Command,
-                                      char* AnswerBuffer, int AnswerLength)
+string CartProgrammer::readFlash(SerialPort& port, ostream& out, uInt32 size,
+                                 Progress& progress)
 {
-  port.send(Command);
-  port.receive(AnswerBuffer, AnswerLength - 1, 2, 5000);
-  size_t cmdlen = strlen(Command);
+  auto handleError = [&](const string& result)
+  {
+    mySession.end();
+    progress.finalize();
 
-  char* FormattedCommand = (char*) alloca(cmdlen+1);
-  lpc_FormatCommand(Command, FormattedCommand);
-  lpc_FormatCommand(AnswerBuffer, AnswerBuffer);
-  cmdlen = strlen(FormattedCommand);
-  return (strncmp(AnswerBuffer, FormattedCommand, cmdlen) == 0 &&
-          strcmp(AnswerBuffer + cmdlen, "0\n") == 0);
-}
+    throw std::runtime_error(result);
+  };
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt8 CartProgrammer::lpc_GetAndReportErrorNumber(const char* Answer)
-{
-  uInt8 Result = 0xFF;    // Error !!!
-  uInt32 i = 0;
+  char cmdstr[64], Answer[128];
+  ostringstream result;
 
-  while (1)
+  myRecordCommands = false;
+  if (string error = lpc_Connect(port); !error.empty())
+    handleError(error);
+  const auto tStart = std::chrono::steady_clock::now();
+
+  const uInt32 FlashSize = LPCtypes[myDetectedDevice].FlashSize * 1024;
+  if (size == 0 || size > FlashSize)
+    size = FlashSize;
+  size = (size + 3) & ~3;  // the read command only accepts whole words
+
+  *myLog << "Reading " << size << " bytes of flash\n";
+  progress.initialize("Reading Flash", 0, size/45 + 1);
+
+  sprintf(cmdstr, "R %d %d\r\n", 0, size);
+  if (!lpc_SendAndVerify(port, cmdstr, Answer, sizeof Answer))
   {
-    if (Answer[i] == 0x00)
-      break;
+    result << "ERROR: Wrong answer on Read-Command " << lpc_GetAndReportErrorNumber(Answer);
+    handleError(result.str());
+  }
 
-    if (Answer[i] == 0x0a)
+  uInt32 Pos = 0, progressStep = 0;
+  if (LPCtypes[myDetectedDevice].ChipVariant == CHIP_VARIANT_LPC8XX)
+  {
+    // Data is sent in binary, without any checksums
+    uInt8 block[256];
+    while (Pos < size)
     {
-      i++;
+      const uInt32 length = std::min<uInt32>(sizeof block, size - Pos);
+      if (port.receiveCompleteBlock(block, length, 5000) != length)
+        handleError("ERROR: Timeout reading data");
 
-      if (Answer[i] < '0' || Answer[i] > '9')
-        break;
+      out.write(reinterpret_cast<const char*>(block), length);
+      Pos += length;
 
-      Result = (unsigned char) (atoi(&Answer[i]));
-      break;
+      if(!progress.updateValue(progressStep += length / 45))
+        handleError("Cancelled read");
     }
-    i++;
   }
-
-  return Result;
-}
-
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void CartProgrammer::lpc_FormatCommand(const char* In, char* Out)
-{
-  size_t i, j;
-  for (i = 0, j = 0; In[j] != '\0'; i++, j++)
+  else
   {
-    if ((In[j] == '\r') || (In[j] == '\n'))
+    // Data arrives in windows of up to 20 uuencoded lines, each window
+    // followed by its checksum; a window is only written out once its
+    // checksum matches, else it's requested again
+    uInt8 window[20 * 45];
+    uInt32 retries = 0;
+    while (Pos < size)
     {
-      if (i > 0) // Ignore leading line breaks (they must be leftovers from a previous answer)
-      {
-        Out[i] = '\n';
-      }
-      else
+      const uInt32 windowSize = std::min<uInt32>(sizeof window, size - Pos);
+      const uInt32 lines = (windowSize + 44) / 45;
+      uInt32 block_CRC = 0;
+      bool valid = true;
+
+      for (uInt32 Line = 0; Line < lines; ++Line)
       {
-        i--;
+        port.receive(Answer, sizeof(Answer)-1, 1, 5000);
+        lpc_FormatCommand(Answer, Answer);
+        if (Uuencode::decodeLine(Answer, window + Line * 45, block_CRC) !=
+            std::min<uInt32>(45, windowSize - Line * 45))
+          valid = false;
       }
-      while ((In[j+1] == '\r') || (In[j+1] == '\n'))
+
+      port.receive(Answer, sizeof(Answer)-1, 1, 5000);
+      valid = valid && strtoul(Answer, nullptr, 10) == block_CRC;
+
+      port.send(valid ? "OK\r\n" : "RESEND\r\n");
+      if (myEchoing)
+        port.receive(Answer, sizeof(Answer)-1, 1, 5000);
+
+      if (!valid)
       {
-        j++;
+        if (++retries >= myRetry)
+        {
+          result << "ERROR: reading block_CRC, retries = " << retries;
+          handleError(result.str());
+        }
+        continue;
       }
-    }
-    else
-    {
-      Out[i] = In[j];
+      retries = 0;
+
+      out.write(reinterpret_cast<const char*>(window), windowSize);
+      Pos += windowSize;
+
+      *myLog << "." << std::flush;
+      if(!progress.updateValue(progressStep += lines))
+        handleError("Cancelled read");
     }
   }
-  Out[i] = '\0';
+
+  if (!out)
+    handleError("ERROR: Couldn't write flash contents");
+
+  progress.finalize();
+
+  const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - tStart).count();
+  result << "Read Finished... " << size << " bytes taking "
+         << std::fixed << std::setprecision(2) << seconds << " seconds";
+
+  *myLog << '\n' << result.str() << '\n';
+  return result.str();
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt32 CartProgrammer::lpc_ReturnValueLpcRamStart() const
+string CartProgrammer::lpc_Connect(SerialPort& port)
 {
-  switch(LPCtypes[myDetectedDevice].ChipVariant)
+  const uInt32 syncBaud = mySession.activeOn(port) ? mySession.syncBaud() : port.getBaud();
+  bool resumed = true;
+  if (lpc_ResumeSession(port))
+    *myLog << "Resuming ISP session with LPC" << LPCtypes[myDetectedDevice].Product << "\n";
+  else
   {
-    case CHIP_VARIANT_LPC43XX:  return LPC_RAMSTART_LPC43XX;
-    case CHIP_VARIANT_LPC2XXX:  return LPC_RAMSTART_LPC2XXX;
-    case CHIP_VARIANT_LPC18XX:  return LPC_RAMSTART_LPC18XX;
-    case CHIP_VARIANT_LPC17XX:  return LPC_RAMSTART_LPC17XX;
-    case CHIP_VARIANT_LPC13XX:  return LPC_RAMSTART_LPC13XX;
-    case CHIP_VARIANT_LPC11XX:  return LPC_RAMSTART_LPC11XX;
-    case CHIP_VARIANT_LPC8XX:   return LPC_RAMSTART_LPC8XX;
+    // Start over at the rate the bootloader synchronizes at
+    if (static_cast<uInt32>(port.getBaud()) != syncBaud)
+      port.changeBaud(syncBaud);
+
+    myNegotiatedBaud = 0;
+    if (string error = lpc_Identify(port); !error.empty())
+      return error;
+    resumed = false;
+  }
 
-    default:  return 0;  // TODO - more properly handle this
+  if (myEchoing)
+    lpc_DisableEcho(port);
+
+  // Move to a faster link, if one is allowed and not already in use
+  if (myNegotiatedBaud == 0 && myMaxBaud > static_cast<uInt32>(port.getBaud()))
+  {
+    myNegotiatedBaud = lpc_NegotiateBaud(port);
+    if (myNegotiatedBaud == 0)
+      return "ERROR: Connection lost during baud rate negotiation";
   }
+
+  if (!resumed)
+    lpc_MeasureLatency(port);
+
+  mySession.start(port, myDetectedDevice, syncBaud);
+  return "";
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt32 CartProgrammer::lpc_ReturnValueLpcRamBase() const
+string CartProgrammer::lpc_Identify(SerialPort& port)
 {
-  switch(LPCtypes[myDetectedDevice].ChipVariant)
-  {
-    case CHIP_VARIANT_LPC43XX:  return LPC_RAMBASE_LPC43XX;
-    case CHIP_VARIANT_LPC2XXX:  return LPC_RAMBASE_LPC2XXX;
-    case CHIP_VARIANT_LPC18XX:  return LPC_RAMBASE_LPC18XX;
-    case CHIP_VARIANT_LPC17XX:  return LPC_RAMBASE_LPC17XX;
-    case CHIP_VARIANT_LPC13XX:  return LPC_RAMBASE_LPC13XX;
-    case CHIP_VARIANT_LPC11XX:  return LPC_RAMBASE_LPC11XX;
-    case CHIP_VARIANT_LPC8XX:   return LPC_RAMBASE_LPC8XX;
+  char Answer[128], temp[128];
+  char *strippedAnswer{nullptr}, *endPtr{nullptr};
+  const char* cmdstr{nullptr};
+  uInt32 Id[2];
+  uInt32 Id1Masked{0};
+  int i{0};
+
+  *myLog << "Synchronizing at " << port.getBaud() << " baud";
+
+  if (string error = lpc_Synchronize(port); !error.empty())
+    return error;
+
+  *myLog << " OK";
+  lpc_LogActualBaud(port);
+  *myLog << "\n";
+
+  *myLog << "Read bootcode version: ";
+
+  cmdstr = "K\r\n";
+  port.send(cmdstr);
+  port.receive(Answer, sizeof(Answer)-1, 4, 5000);
+
+  lpc_FormatCommand(cmdstr, temp);
+  lpc_FormatCommand(Answer, Answer);
+  if (strncmp(Answer, temp, strlen(temp)) != 0)
+    return "ERROR: no answer on Read Boot Code Version";
+
+  if (strncmp(Answer + strlen(temp), "0\n", 2) == 0)
+  {
+    strippedAnswer = Answer + strlen(temp) + 2;
+    *myLog << strippedAnswer;
+  }
+  else
+    *myLog << "unknown\n";
+
+  *myLog << "Read part ID: ";
+
+  cmdstr = "J\r\n";
+  port.send(cmdstr);
+  port.receive(Answer, sizeof(Answer)-1, 3, 5000);
+
+  lpc_FormatCommand(cmdstr, temp);
+  lpc_FormatCommand(Answer, Answer);
+  if (strncmp(Answer, temp, strlen(temp)) != 0)
+    return "ERROR: no answer on Read Part Id";
+
+  strippedAnswer = (strncmp(Answer, "J\n0\n", 4) == 0) ? Answer + 4 : Answer;
+
+  Id[0] = strtoul(strippedAnswer, &endPtr, 10);
+  Id[1] = 0UL;
+  *endPtr = '\0'; /* delete \r\n */
+  for (i = sizeof LPCtypes / sizeof LPCtypes[0] - 1; i > 0 && LPCtypes[i].id != Id[0]; i--)
+    /* nothing */;
+
+  myDetectedDevice = i;
+
+  if (LPCtypes[myDetectedDevice].EvalId2 != 0)
+  {
+    /* Read out the second configuration word and run the search again */
+    *endPtr = '\n';
+    endPtr++;
+    if ((endPtr[0] == '\0') || (endPtr[strlen(endPtr)-1] != '\n'))
+    {
+      /* No or incomplete word 2 */
+      port.receive(endPtr, sizeof(Answer)-(endPtr-Answer)-1, 1, 100);
+    }
+
+    lpc_FormatCommand(endPtr, endPtr);
+    if ((*endPtr == '\0') || (*endPtr == '\n'))
+      return "ERROR: incomplete answer on Read Part Id (second configuration word missing)";
+
+    Id[1] = strtoul(endPtr, &endPtr, 10);
+    *endPtr = '\0'; /* delete \r\n */
+
+    Id1Masked = Id[1] & 0xFF;
+
+    /* now search the table again */
+    for (i = sizeof LPCtypes / sizeof LPCtypes[0] - 1; i > 0 &&
+        (LPCtypes[i].id != Id[0] || LPCtypes[i].id2 != Id1Masked); i--)
+      /* nothing */;
+    myDetectedDevice = i;
+  }
+  if (myDetectedDevice == 0)
+  {
+    *myLog << "unknown";
+  }
+  else
+  {
+    char version[100];
+    sprintf(version, "LPC%s, %d kiB FLASH / %d kiB SRAM",
+            LPCtypes[myDetectedDevice].Product,
+            LPCtypes[myDetectedDevice].FlashSize,
+            LPCtypes[myDetectedDevice].RAMSize);
+    *myLog << version;
+  }
+  if (LPCtypes[myDetectedDevice].EvalId2 != 0)
+    *myLog << " (" << std::hex << Id[0] << "/" << Id[1] << " -> " << Id1Masked << std::dec << ")\n";
+  else
+    *myLog << " (" << std::hex << Id[0] << std::dec << ")\n";
+
+  return "";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CartProgrammer::lpc_ResumeSession(SerialPort& port)
+{
+  if (!mySession.activeOn(port))
+    return false;
+
+  // Only valid again once the connection is complete
+  const uInt32 device = mySession.device();
+  mySession.end();
+
+  // Reading the part ID proves that the bootloader is still listening,
+  // at this rate and with the echo state we expect
+  char Answer[128];
+  port.clearBuffers();
+  port.send("J\r\n");
+  port.receive(Answer, sizeof(Answer)-1, myEchoing ? 3 : 2, 500);
+  lpc_FormatCommand(Answer, Answer);
+
+  const char* id = Answer;
+  if (myEchoing)
+  {
+    if (strncmp(id, "J\n", 2) != 0)
+      return false;
+    id += 2;
+  }
+  if (strncmp(id, "0\n", 2) != 0 || strtoul(id + 2, nullptr, 10) != LPCtypes[device].id)
+    return false;
+
+  // The second configuration word isn't needed to know it's the same part
+  if (LPCtypes[device].EvalId2 != 0)
+    port.receive(Answer, sizeof(Answer)-1, 1, 100);
+
+  myDetectedDevice = device;
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartProgrammer::lpc_MeasureLatency(SerialPort& port)
+{
+  // What the link adds to every command is the fastest of a few 'J' round
+  // trips, less the time the characters themselves spend on the wire
+  const size_t lines = (myEchoing ? 3 : 2) + (LPCtypes[myDetectedDevice].EvalId2 != 0 ? 1 : 0);
+  const double charTime = 10.0 / port.getBaud();
+  double best = 1.0;
+
+  for (int i = 0; i < 3; ++i)
+  {
+    char Answer[128];
+    const auto tStart = std::chrono::steady_clock::now();
+    port.send("J\r\n");
+    const size_t size = port.receive(Answer, sizeof(Answer)-1, lines, 500);
+    const double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - tStart).count();
+    if (size == 0)
+      return;
+
+    best = std::min(best, seconds - (3 + size) * charTime);
+  }
+  *myLog << "Link latency: " << std::round(std::max(best, 0.0) * 10000) / 10
+         << " ms per command\n";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string CartProgrammer::lpc_Synchronize(SerialPort& port)
+{
+  char Answer[128], temp[128];
+
+  if (!lpc_AwaitBootloader(port))
+    return "ERROR: no answer on '?'";
+
+  // The bootloader always starts out echoing commands
+  myEchoing = true;
+
+  port.send("Synchronized\r\n");
+  port.receive(Answer, sizeof(Answer) - 1, 2, 1000);
+
+  lpc_FormatCommand(Answer, Answer);
+  if (strcmp(Answer, "Synchronized\nOK\n") != 0)
+    return "ERROR: No answer on 'Synchronized'";
+
+  sprintf(temp, "%s\r\n", myOscillator.c_str());
+  port.send(temp);
+  port.receive(Answer, sizeof(Answer)-1, 2, 1000);
+
+  sprintf(temp, "%s\nOK\n", myOscillator.c_str());
+  lpc_FormatCommand(Answer, Answer);
+  if (strcmp(Answer, temp) != 0)
+    return "ERROR: No answer on Oscillator-Command";
+
+  if (!lpc_SendAndVerify(port, "U 23130\r\n", Answer, sizeof Answer))
+    return "ERROR: Unlock-Command: " + std::to_string(lpc_GetAndReportErrorNumber(Answer));
+
+  return "";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CartProgrammer::lpc_AwaitBootloader(SerialPort& port)
+{
+  char Answer[128];
+  uInt32 silentAttempts = 0;
+
+  for (uInt32 attempt = 0; attempt < myConnectionAttempts; attempt++)
+  {
+    // Unless it's booting already, the target may be waiting for the '?',
+    // so it's only reset from the second attempt on
+    const bool probing = attempt == 0 && !myBooting;
+    if (attempt > 0)
+      reset(port);
+
+    // Skip the part of the boot time known from last time; once the target
+    // has gone quiet at the largest window, it's most likely not there
+    uInt32 elapsed = 0, window = ourPollTime;
+    if (!probing)
+    {
+      window = myBootTime > 0 ? 2 * myBootTime + 2 * ourPollTime : ourBootWindow;
+      window = std::min(window << silentAttempts, ourMaxBootWindow);
+      if (myBootTime > ourPollTime)
+      {
+        elapsed = myBootTime - ourPollTime;
+        port.sleepMillis(elapsed);
+      }
+    }
+
+    *myLog << ".";
+    bool silent = true;
+    for (; elapsed < window; elapsed += ourPollTime)
+    {
+      port.send("?");
+
+      memset(Answer, 0, sizeof(Answer));
+      int strippedsize = static_cast<int>(port.receive(Answer, sizeof(Answer)-1, 1, ourPollTime));
+      char* strippedAnswer = Answer;
+      silent = silent && strippedsize == 0;
+
+      while ((strippedsize > 0) && ((*strippedAnswer == '?') || (*strippedAnswer == 0)))
+      {
+        strippedAnswer++;
+        strippedsize--;
+      }
+
+      lpc_FormatCommand(strippedAnswer, strippedAnswer);
+      if (strcmp(strippedAnswer, "Synchronized\n") == 0)
+      {
+        if (myBooting)
+        {
+          // Clear the RTS line after having reset the micro
+          // Needed for the "GO <Address> <Mode>" ISP command to work
+          port.controlModemLines(0, 0);
+          myBooting = false;
+        }
+        if (!probing && myBootTime != elapsed)
+        {
+          *myLog << " (bootloader answered after " << elapsed << " ms)";
+          myBootTime = elapsed;
+        }
+        return true;
+      }
+    }
+
+    if (silent && !probing)
+    {
+      if (window == ourMaxBootWindow)
+        break;
+      silentAttempts++;
+    }
+  }
+
+  return false;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartProgrammer::lpc_DisableEcho(SerialPort& port)
+{
+  // Turn off echo for the rest of the session; answers then only contain
+  // the return codes, and data lines aren't sent back at all
+  // The LPC8xx is left alone, since its binary data transfer relies on
+  // the echo to verify what was received
+  if (myEchoOff && LPCtypes[myDetectedDevice].ChipVariant != CHIP_VARIANT_LPC8XX)
+  {
+    char Answer[128];
+    if (lpc_SendAndVerify(port, "A 0\r\n", Answer, sizeof Answer))
+      myEchoing = false;
+    else
+      *myLog << "Couldn't turn off echo, continuing with echo on\n";
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 CartProgrammer::lpc_NegotiateBaud(SerialPort& port)
+{
+  // Rates accepted by the 'B' command, above the usual autobaud rate
+  static constexpr std::array<uInt32, 3> rates = { 57600, 115200, 230400 };
+
+  const uInt32 initialBaud = port.getBaud();
+  uInt32 goodBaud = initialBaud, maxBaud = myMaxBaud;
+
+  // Get back in sync at the initial rate, after a failed rate switch
+  // leaves the bootloader and the port talking at different rates
+  auto resync = [&]()
+  {
+    *myLog << "Resynchronizing at " << initialBaud << " baud";
+    port.changeBaud(initialBaud);
+    reset(port);
+    if (!lpc_Synchronize(port).empty())
+      return false;
+
+    *myLog << " OK\n";
+    lpc_DisableEcho(port);
+    return true;
+  };
+
+  // A rate that worked for this port and device before will most likely
+  // work again, so try it before stepping up one rate at a time
+  if (myPreferredBaud > initialBaud && myPreferredBaud <= maxBaud &&
+      BSPF::contains(rates, myPreferredBaud))
+  {
+    BaudSwitch status = lpc_SwitchBaud(port, myPreferredBaud);
+    if (status == BaudSwitch::Switched)
+      return myPreferredBaud;
+    else if (status == BaudSwitch::Failed && !resync())
+      return 0;
+
+    maxBaud = myPreferredBaud - 1;
+  }
+
+  for (auto baud: rates)
+  {
+    if (baud <= goodBaud || baud > maxBaud)
+      continue;
+
+    BaudSwitch status = lpc_SwitchBaud(port, baud);
+    if (status == BaudSwitch::Switched)
+    {
+      goodBaud = baud;
+      continue;
+    }
+    else if (status == BaudSwitch::Failed)
+    {
+      if (!resync())
+        return 0;
+
+      // The previous rate was fine, so go back to it directly
+      if (goodBaud != initialBaud && lpc_SwitchBaud(port, goodBaud) != BaudSwitch::Switched)
+      {
+        goodBaud = initialBaud;
+        if (!resync())
+          return 0;
+      }
+    }
+    break;
+  }
+
+  return goodBaud;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+CartProgrammer::BaudSwitch CartProgrammer::lpc_SwitchBaud(SerialPort& port, uInt32 baud)
+{
+  char cmdstr[32], Answer[128], Expected[64];
+
+  *myLog << "Switching to " << baud << " baud... " << std::flush;
+
+  // The answer to 'B' still arrives at the old rate
+  sprintf(cmdstr, "B %d 1\r\n", baud);
+  if (!lpc_SendAndVerify(port, cmdstr, Answer, sizeof Answer))
+  {
+    *myLog << "not supported\n";
+    return BaudSwitch::Refused;
+  }
+  if (!port.changeBaud(baud))
+  {
+    *myLog << "not supported by serial port\n";
+    return BaudSwitch::Failed;
+  }
+
+  // Validate the new rate with a burst of part ID reads, all sent before
+  // any of the answers are checked
+  static constexpr int BURST = 4;
+  const size_t lines = (myEchoing ? 3 : 2) + (LPCtypes[myDetectedDevice].EvalId2 != 0 ? 1 : 0);
+  sprintf(Expected, "%s0\n%u\n", myEchoing ? "J\n" : "", LPCtypes[myDetectedDevice].id);
+
+  for (int i = 0; i < BURST; i++)
+    port.send("J\r\n");
+
+  for (int i = 0; i < BURST; i++)
+  {
+    port.receive(Answer, sizeof(Answer)-1, lines, 250);
+    lpc_FormatCommand(Answer, Answer);
+    if (strncmp(Answer, Expected, strlen(Expected)) != 0)
+    {
+      *myLog << "failed\n";
+      return BaudSwitch::Failed;
+    }
+  }
+
+  *myLog << "OK";
+  lpc_LogActualBaud(port);
+  *myLog << "\n";
+  return BaudSwitch::Switched;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartProgrammer::lpc_LogActualBaud(SerialPort& port)
+{
+  const double baud = port.getBaud(), actual = port.actualBaud();
+  if (actual != baud)
+    *myLog << " (port runs at " << actual << " baud, "
+           << std::round(1000 * (actual - baud) / baud) / 10 << "% off)";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CartProgrammer::lpc_Compare(SerialPort& port, uInt32 FlashAddress,
+                                 uInt32 RamAddress, uInt32 Count)
+{
+  char cmdstr[64], Answer[128];
+
+  sprintf(cmdstr, "M %d %d %d\r\n", FlashAddress, RamAddress, Count);
+  if (lpc_SendAndVerify(port, cmdstr, Answer, sizeof Answer))
+    return true;
+
+  // COMPARE_ERROR (10) is followed by the offset of the first mismatch
+  if (lpc_GetAndReportErrorNumber(Answer) == 10)
+    port.receive(Answer, sizeof(Answer)-1, 1, 500);
+
+  return false;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartProgrammer::lpc_FindBlankSectors(SerialPort& port, uInt32 first,
+                                          uInt32 last, BoolArray& blank)
+{
+  const uInt32* SectorTable = LPCtypes[myDetectedDevice].SectorTable;
+  char cmdstr[64], Answer[128];
+
+  uInt32 start = 0;
+  for (uInt32 s = 0; s < first; ++s)
+    start += SectorTable[s];
+
+  while (first <= last)
+  {
+    sprintf(cmdstr, "I %d %d\r\n", first, last);
+    if (lpc_SendAndVerify(port, cmdstr, Answer, sizeof Answer))
+    {
+      for (uInt32 s = first; s <= last; ++s)
+        blank[s] = true;
+      return;
+    }
+
+    // Anything but SECTOR_NOT_BLANK (8) leaves the sectors to be erased
+    if (lpc_GetAndReportErrorNumber(Answer) != 8)
+      return;
+
+    // The answer is followed by the offset and contents of the first
+    // non-blank word; every sector before the one holding it is blank
+    port.receive(Answer, sizeof(Answer)-1, 2, 500);
+    const uInt32 offset = strtoul(Answer, nullptr, 10);
+
+    uInt32 end = start;
+    for (uInt32 s = first; s <= last; ++s)
+      end += SectorTable[s];
+    if (offset >= end)
+      return;
+
+    while (start + SectorTable[first] <= offset)
+    {
+      blank[first] = true;
+      start += SectorTable[first++];
+    }
+
+    // Continue after the sector that isn't blank
+    start += SectorTable[first++];
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartProgrammer::lpc_CheckFlashCache(SerialPort& port, const uInt8* data,
+                                         uInt32 size, BoolArray& cached)
+{
+  const uInt32* SectorTable = LPCtypes[myDetectedDevice].SectorTable;
+
+  myFlashCache->load(port.getID(), partID());
+
+  // Without remembering flash contents, only an unfinished download is
+  // picked up again
+  const bool resuming = !myFlashCache->complete();
+  if (!resuming && !myRememberFlash)
+    return;
+
+  // Sector 0 holds the checksum, and is always programmed
+  uIntArray candidates;
+  string hashes;
+  uInt32 start = SectorTable[0];
+  for (uInt32 sector = 1; sector < cached.size() && start < size;
+       start += SectorTable[sector], ++sector)
+  {
+    const uInt32 length = std::min(SectorTable[sector], size - start);
+    const string hash = FlashCache::hash(data + start, length);
+    if (myFlashCache->matches(sector, hash))
+    {
+      candidates.push_back(sector);
+      hashes += hash;
+    }
+  }
+  if (candidates.empty())
+    return;
+
+  // The flash may have been changed behind our back, so check a block from
+  // one of the sectors before trusting any of them.  The block is picked
+  // from the sectors' contents rather than at random, so the same image
+  // and cache entry always send the same commands (as a replayed capture
+  // of the session expects).
+  std::seed_seq seed(hashes.begin(), hashes.end());
+  std::mt19937 random(seed);
+  const uInt32 sector = candidates[random() % candidates.size()];
+  start = 0;
+  for (uInt32 i = 0; i < sector; ++i)
+    start += SectorTable[i];
+  const uInt32 length = std::min(SectorTable[sector], size - start);
+  const uInt32 offset = (random() % ((length + 179) / 180)) * 180;
+
+  if (!lpc_SpotCheck(port, data + start + offset, start + offset,
+                     std::min<uInt32>(180, length - offset)))
+  {
+    *myLog << "Flash contents of sector " << sector
+           << " don't match the cache; discarding it\n";
+    myFlashCache->clear();
+    return;
+  }
+
+  for (auto s: candidates)
+    cached[s] = true;
+  if (resuming)
+    *myLog << candidates.size() << " sector(s) done by the unfinished last download\n";
+  else
+    *myLog << candidates.size() << " sector(s) unchanged since last download\n";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CartProgrammer::lpc_SpotCheck(SerialPort& port, const uInt8* data,
+                                   uInt32 FlashAddress, uInt32 Count)
+{
+  char cmdstr[64], Answer[128], Expected[64], Lines[4][Uuencode::LINE_SIZE];
+  char Echo[4 * 128];
+  std::string_view blocks[4];
+  uInt32 blockCRC = 0;
+
+  sprintf(cmdstr, "W %d 180\r\n", lpc_ReturnValueLpcRamBase());
+  if (!lpc_SendAndVerify(port, cmdstr, Answer, sizeof Answer))
+    return false;
+
+  for (int i = 0; i < 4; ++i)
+  {
+    blockCRC += Uuencode::encodeLine(data + i * 45, Lines[i]);
+    blocks[i] = std::string_view(Lines[i], Uuencode::LINE_SIZE - 1);
+  }
+  port.sendv(blocks);
+  if (myEchoing)
+    port.receive(Echo, sizeof(Echo)-1, 4, 5000);
+
+  sprintf(cmdstr, "%d\r\n", blockCRC);
+  port.send(cmdstr);
+  port.receive(Answer, sizeof(Answer)-1, myEchoing ? 2 : 1, 5000);
+  if (myEchoing)
+    sprintf(Expected, "%d\nOK\n", blockCRC);
+  else
+    strcpy(Expected, "OK\n");
+  lpc_FormatCommand(Answer, Answer);
+  if (strcmp(Answer, Expected) != 0)
+    return false;
+
+  return lpc_Compare(port, FlashAddress, lpc_ReturnValueLpcRamBase(), Count);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartProgrammer::lpc_AdaptWindow(uInt32 lines, uInt32 retries)
+{
+  // Estimate the chance of a line getting through, from the share of
+  // windows that had to be resent; older windows count for less, so the
+  // estimate follows a link that changes
+  myWindowsSent += retries + 1;
+  myWindowErrors += retries;
+  myWindowLinesSent += lines * (retries + 1);
+  if (myWindowsSent > 50)
+  {
+    myWindowsSent /= 2;
+    myWindowErrors /= 2;
+    myWindowLinesSent /= 2;
+  }
+  const double lineOK = std::pow(1.0 - myWindowErrors / myWindowsSent,
+                                 myWindowsSent / myWindowLinesSent);
+
+  // Every error costs a whole window of lines to resend, while every window
+  // costs a checksum handshake, and below the bootloader's own 20 lines an
+  // extra 'W' command too (each about as long as sending a line); pick the
+  // window with the least expected cost per line
+  uInt32 newWindow = MaxWindowLines;
+  double bestCost = 0;
+  for (uInt32 n = MinWindowLines; n <= MaxWindowLines; n += 4)
+  {
+    const double cost = (n + 1 + (n < MaxWindowLines ? 1 : 0)) / std::pow(lineOK, n) / n;
+    if (n == MinWindowLines || cost < bestCost)
+    {
+      newWindow = n;
+      bestCost = cost;
+    }
+  }
+
+  if (newWindow != myWindowLines)
+  {
+    *myLog << " (" << std::round(1000 * (1 - lineOK)) / 10 << "% line errors, now "
+           << newWindow << " lines per checksum)" << std::flush;
+    myWindowLines = newWindow;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int CartProgrammer::lpc_SendAndVerify(SerialPort& port, const char* Command,
+                                      char* AnswerBuffer, int AnswerLength)
+{
+  if (myRecordCommands)
+    myTransferPlan.addCommand(Command);
+  port.send(Command);
+
+  // Without echo, the answer consists of only the return code
+  if (!myEchoing)
+  {
+    lpc_FormatCommand(port.receiveLines(1, 5000, AnswerLength - 1), AnswerBuffer);
+    return strcmp(AnswerBuffer, "0\n") == 0;
+  }
+
+  lpc_FormatCommand(port.receiveLines(2, 5000, AnswerLength - 1), AnswerBuffer);
+  size_t cmdlen = strlen(Command);
+
+  char* FormattedCommand = (char*) alloca(cmdlen+1);
+  lpc_FormatCommand(Command, FormattedCommand);
+  cmdlen = strlen(FormattedCommand);
+  return (strncmp(AnswerBuffer, FormattedCommand, cmdlen) == 0 &&
+          strcmp(AnswerBuffer + cmdlen, "0\n") == 0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt8 CartProgrammer::lpc_GetAndReportErrorNumber(const char* Answer)
+{
+  uInt8 Result = 0xFF;    // Error !!!
+  uInt32 i = 0;
+
+  // Without echo, the error number is at the start of the answer
+  if (!myEchoing && Answer[0] >= '0' && Answer[0] <= '9')
+    return (unsigned char) (atoi(Answer));
+
+  while (1)
+  {
+    if (Answer[i] == 0x00)
+      break;
+
+    if (Answer[i] == 0x0a)
+    {
+      i++;
+
+      if (Answer[i] < '0' || Answer[i] > '9')
+        break;
+
+      Result = (unsigned char) (atoi(&Answer[i]));
+      break;
+    }
+    i++;
+  }
+
+  return Result;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartProgrammer::lpc_FormatCommand(std::string_view In, char* Out)
+{
+  size_t i, j;
+  for (i = 0, j = 0; j < In.size(); i++, j++)
+  {
+    if ((In[j] == '\r') || (In[j] == '\n'))
+    {
+      if (i > 0) // Ignore leading line breaks (they must be leftovers from a previous answer)
+      {
+        Out[i] = '\n';
+      }
+      else
+      {
+        i--;
+      }
+      while ((j+1 < In.size()) && ((In[j+1] == '\r') || (In[j+1] == '\n')))
+      {
+        j++;
+      }
+    }
+    else
+    {
+      Out[i] = In[j];
+    }
+  }
+  Out[i] = '\0';
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 CartProgrammer::lpc_ReturnValueLpcRamStart() const
+{
+  switch(LPCtypes[myDetectedDevice].ChipVariant)
+  {
+    case CHIP_VARIANT_LPC43XX:  return LPC_RAMSTART_LPC43XX;
+    case CHIP_VARIANT_LPC2XXX:  return LPC_RAMSTART_LPC2XXX;
+    case CHIP_VARIANT_LPC18XX:  return LPC_RAMSTART_LPC18XX;
+    case CHIP_VARIANT_LPC17XX:  return LPC_RAMSTART_LPC17XX;
+    case CHIP_VARIANT_LPC13XX:  return LPC_RAMSTART_LPC13XX;
+    case CHIP_VARIANT_LPC11XX:  return LPC_RAMSTART_LPC11XX;
+    case CHIP_VARIANT_LPC8XX:   return LPC_RAMSTART_LPC8XX;
+
+    default:  return 0;  // TODO - more properly handle this
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 CartProgrammer::lpc_ReturnValueLpcRamBase() const
+{
+  switch(LPCtypes[myDetectedDevice].ChipVariant)
+  {
+    case CHIP_VARIANT_LPC43XX:  return LPC_RAMBASE_LPC43XX;
+    case CHIP_VARIANT_LPC2XXX:  return LPC_RAMBASE_LPC2XXX;
+    case CHIP_VARIANT_LPC18XX:  return LPC_RAMBASE_LPC18XX;
+    case CHIP_VARIANT_LPC17XX:  return LPC_RAMBASE_LPC17XX;
+    case CHIP_VARIANT_LPC13XX:  return LPC_RAMBASE_LPC13XX;
+    case CHIP_VARIANT_LPC11XX:  return LPC_RAMBASE_LPC11XX;
+    case CHIP_VARIANT_LPC8XX:   return LPC_RAMBASE_LPC8XX;
 
     default:  return 0;  // TODO - more properly handle this
   }
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool CartProgrammer::deviceLayout(const string& product, uInt32& id, uInt32& id2,
+                                  uIntArray& sectors, uInt32& ramKB)
+{
+  for(const auto& type: LPCtypes)
+  {
+    if(type.ChipVariant != CHIP_VARIANT_LPC2XXX || product != type.Product)
+      continue;
+
+    id  = type.id;
+    id2 = type.id2;
+    sectors.assign(type.SectorTable, type.SectorTable + type.FlashSectors);
+    ramKB = type.RAMSize;
+    return true;
+  }
+  return false;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 const uInt32 CartProgrammer::SectorTable_210x[] = {
   8192, 8192, 8192, 8192, 8192, 8192, 8192, 8192,
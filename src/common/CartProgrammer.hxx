@@ -18,7 +18,11 @@
 class SerialPort;
 
 #include "bspf.hxx"
+#include "IspSession.hxx"
 #include "Progress.hxx"
+#include "TransferPlan.hxx"
+
+class FlashCache;
 
 /**
   Cart programming routines for the Harmony cart.
@@ -36,7 +40,9 @@ class CartProgrammer
     ~CartProgrammer() = default;
 
     /**
-      Resets the target to program/download mode.
+      Resets the target to program/download mode.  The bootloader is given
+      time to start up by the next synchronization, which polls for it to
+      answer rather than waiting a fixed time.
     */
     void reset(SerialPort& port);
 
@@ -46,6 +52,98 @@ class CartProgrammer
     /** Set number of write retries before bailing out. */
     void setRetry(uInt32 retry) { myRetry = retry; }
 
+    /**
+      Send each window of data lines without waiting for the echo of every
+      line; echoes are checked once per window, before its checksum.
+    */
+    void setPipelined(bool pipelined) { myPipelined = pipelined; }
+
+    /**
+      Turn off the bootloader echo ('A 0') once the part has been identified,
+      so that only return codes are sent back for the rest of the session.
+    */
+    void setEchoOff(bool echoOff) { myEchoOff = echoOff; }
+
+    /**
+      Only program sectors whose contents differ from the new data; each
+      sector is compared against flash after its data is written to RAM,
+      and erased and copied only when needed.  Sector 0 is always
+      programmed, last.
+    */
+    void setDifferential(bool differential) { myDifferential = differential; }
+
+    /**
+      Where RAM is large enough, write the data for several sectors to RAM
+      with a single 'W' command, and then copy each sector to flash from
+      there, instead of one 'W' command per sector.
+    */
+    void setStaged(bool staged) { myStaged = staged; }
+
+    /**
+      Blank-check the sectors to be programmed before erasing them, and
+      only erase those that aren't blank already.
+    */
+    void setBlankCheck(bool blankCheck) { myBlankCheck = blankCheck; }
+
+    /**
+      Use the given cache to record what is written to each sector, as the
+      download goes.  When a download fails or is cancelled, the next one
+      skips the sectors it completed; with 'remember' set, sectors known
+      to already hold the new data from earlier downloads are skipped as
+      well.  Skipped sectors aren't sent at all, and one of them is
+      spot-checked against flash before the cache is trusted.  A nullptr
+      disables the cache, and with it resuming downloads.
+    */
+    void setFlashCache(FlashCache* cache, bool remember = true) {
+      myFlashCache = cache;  myRememberFlash = remember;
+    }
+
+    /**
+      Set the highest baud rate to negotiate with the bootloader after
+      synchronization; rates at or below the port's rate disable negotiation.
+    */
+    void setMaxBaud(uInt32 baud) { myMaxBaud = baud; }
+
+    /**
+      Set a baud rate known to have worked before, to try before stepping
+      up one rate at a time.
+    */
+    void setPreferredBaud(uInt32 baud) { myPreferredBaud = baud; }
+
+    /**
+      The baud rate settled on during the last download, or 0 if no
+      negotiation took place.
+    */
+    uInt32 negotiatedBaud() const { return myNegotiatedBaud; }
+
+    /**
+      Answers whether the bootloader is still known to be synchronized on
+      the given port, so the next operation can pick up where the last one
+      left off (after checking with a single command) instead of resetting
+      the cart.
+    */
+    bool sessionActive(const SerialPort& port) const {
+      return mySession.activeOn(port);
+    }
+
+    /** Forget the ISP session, e.g. when its port is closed. */
+    void endSession() { mySession.end(); }
+
+    /** The part ID of the last detected device (0 for none). */
+    uInt32 partID() const {
+      return myDetectedDevice != 0 ? LPCtypes[myDetectedDevice].id : 0;
+    }
+
+    /**
+      Set the time the bootloader took to answer after a reset on this
+      port before (in milliseconds, 0 if unknown); polling for it starts
+      shortly before then.
+    */
+    void setBootTime(uInt32 millis) { myBootTime = millis; }
+
+    /** The time the bootloader took to answer after the last reset. */
+    uInt32 bootTime() const { return myBootTime; }
+
     /**
       Log all output to the given stream.
     */
@@ -56,7 +154,165 @@ class CartProgrammer
     string download(SerialPort& port, uInt8* data, uInt32 size,
                     Progress& progress, bool verify, bool continueOnError);
 
+    /**
+      Read the contents of flash, writing them to the given stream as they
+      arrive; only one window of data (900 bytes) is held in memory.  Note
+      that the first 64 bytes read back as the boot block, since that's
+      what is mapped there while the bootloader runs.
+
+      @param size  Number of bytes to read, or 0 for all of flash
+      @return  A summary of the read; errors are thrown as runtime_error
+    */
+    string readFlash(SerialPort& port, ostream& out, uInt32 size,
+                     Progress& progress);
+
+    /**
+      Write the transfer plan of the last download (encoded lines, window
+      checksums and the commands that were sent) to the given stream.
+    */
+    void dumpTransferPlan(ostream& out) const { myTransferPlan.dump(out); }
+
+    /**
+      Look up an LPC2xxx device by its product name (e.g. "2103"), for
+      emulating it.  The second ID word is 0 for parts that don't have one.
+
+      @return  False if there's no such device
+    */
+    static bool deviceLayout(const string& product, uInt32& id, uInt32& id2,
+                             uIntArray& sectors, uInt32& ramKB);
+
   private:
+    enum class BaudSwitch { Switched, Refused, Failed };
+
+    /**
+      Connect to the bootloader, resuming the current ISP session if there
+      is one, else synchronizing and identifying the device; then set up
+      the link (echo and baud rate) as configured.
+
+      @return  An empty string on success, else the error
+    */
+    string lpc_Connect(SerialPort& port);
+
+    /**
+      Synchronize with the bootloader and identify the device.
+
+      @return  An empty string on success, else the error
+    */
+    string lpc_Identify(SerialPort& port);
+
+    /**
+      Check that the bootloader of the current ISP session still answers
+      on the given port, using the cheap 'J' (read part ID) command.
+
+      @return  True if the session can be used, else false (and it's ended)
+    */
+    bool lpc_ResumeSession(SerialPort& port);
+
+    /**
+      Time a few 'J' (read part ID) commands, and report how long the
+      link (serial driver, USB adapter and bootloader) takes to answer a
+      command, on top of sending the characters themselves.
+    */
+    void lpc_MeasureLatency(SerialPort& port);
+
+    /**
+      Synchronize with the bootloader (autobaud, oscillator frequency and
+      unlock), leaving it ready to accept commands with echo on.
+
+      @return  An empty string on success, else the error
+    */
+    string lpc_Synchronize(SerialPort& port);
+
+    /**
+      Wait for the bootloader to answer the autobaud '?' with
+      "Synchronized".  A target that isn't known to be booting is first
+      asked once, since it may already be waiting; after that it's reset,
+      and polled every 50 ms until it answers.  The time it takes is
+      measured, and used to start polling later on the next reset.  Only
+      when a target stays silent is it given more time on each attempt,
+      up to 2 seconds, after which it's assumed not to be there at all.
+
+      @return  True if the bootloader answered, else false
+    */
+    bool lpc_AwaitBootloader(SerialPort& port);
+
+    /**
+      Turn off the bootloader echo, if requested and usable for this part.
+    */
+    void lpc_DisableEcho(SerialPort& port);
+
+    /**
+      Switch the link to the fastest baud rate that works, up to the
+      maximum set with setMaxBaud().  Should a rate fail validation, the
+      target is reset and resynchronized at the port's initial rate.
+
+      @return  The baud rate now in use, or 0 if synchronization was lost
+    */
+    uInt32 lpc_NegotiateBaud(SerialPort& port);
+
+    /**
+      Ask the bootloader to switch to the given baud rate, follow with the
+      port, and validate the new rate.
+
+      @return  Whether the rate is now in use, was refused by the bootloader
+               (old rate still in use), or failed (synchronization lost)
+    */
+    BaudSwitch lpc_SwitchBaud(SerialPort& port, uInt32 baud);
+
+    /**
+      Log the rate the serial port actually runs at, if the hardware can't
+      produce the requested one exactly.
+    */
+    void lpc_LogActualBaud(SerialPort& port);
+
+    /**
+      Compare flash with RAM, using the 'M' command.
+
+      @return  True if both areas hold the same data, else false
+    */
+    bool lpc_Compare(SerialPort& port, uInt32 FlashAddress,
+                     uInt32 RamAddress, uInt32 Count);
+
+    /**
+      Blank-check the given range of sectors with the 'I' command, and mark
+      the sectors found to be blank.  The range is checked with one command
+      when it's entirely blank; otherwise checking continues after each
+      sector found not to be blank.
+    */
+    void lpc_FindBlankSectors(SerialPort& port, uInt32 first, uInt32 last,
+                              BoolArray& blank);
+
+    /**
+      Load the flash cache entry for the connected cart, and mark each
+      sector the cache claims already holds the given data; entries of
+      completed downloads are only used when remembering flash contents.
+      One of these sectors is spot-checked; if it doesn't hold what the
+      cache claims, the entry is discarded and no sectors are marked.
+    */
+    void lpc_CheckFlashCache(SerialPort& port, const uInt8* data, uInt32 size,
+                             BoolArray& cached);
+
+    /**
+      Write 180 bytes (4 uuencoded lines) to RAM, and compare the first
+      Count of them with flash at the given address.
+
+      @return  True if flash holds the same data, else false
+    */
+    bool lpc_SpotCheck(SerialPort& port, const uInt8* data,
+                       uInt32 FlashAddress, uInt32 Count);
+
+    /**
+      Adjust the number of data lines sent per checksum to the rate of
+      checksum errors seen so far: smaller windows on a noisy link mean
+      less to resend per error, bigger ones on a clean link mean fewer
+      handshakes.  The bootloader always asks for a checksum after 20
+      lines, so smaller windows are sent as separate 'W' commands.
+
+      @param lines    Number of lines in the window
+      @param retries  Number of times the window had to be resent
+    */
+    void lpc_AdaptWindow(uInt32 lines, uInt32 retries);
+
     /**
       Download the file from the internal memory image to the philips
       microcontroller.
@@ -80,10 +336,13 @@ class CartProgrammer
       Deal with commands that are variously terminated with either <CR><LF>
       or only <LF>.
 
-      @param In   Pointer to input buffer
-      @param Out  Pointer to output buffer
+      @param In   The input, e.g. an answer still in the port's receive buffer
+      @param Out  Pointer to output buffer (may be the same as In)
     */
-    void lpc_FormatCommand(const char* In, char* Out);
+    void lpc_FormatCommand(std::string_view In, char* Out);
+    void lpc_FormatCommand(const char* In, char* Out) {
+      lpc_FormatCommand(std::string_view(In), Out);
+    }
 
     uInt32 lpc_ReturnValueLpcRamStart() const;
     uInt32 lpc_ReturnValueLpcRamBase() const;
@@ -161,6 +420,12 @@ class CartProgrammer
      */
     enum { LPC_FLASHMASK =  0xFFC00000 /* 22 bits = 4 MB */ };
 
+    /* Number of uuencoded lines sent per checksum: the bootloader asks for
+     * one after 20 lines, and windows are kept to whole blocks of 4 lines
+     * (180 bytes, a multiple of 4 as the 'W' command requires)
+     */
+    enum { MinWindowLines = 4, MaxWindowLines = 20 };
+
     enum CHIP_VARIANT {
       CHIP_VARIANT_NONE,
       CHIP_VARIANT_LPC43XX,
@@ -210,8 +475,30 @@ class CartProgrammer
     uInt32 myDetectedDevice{0};
     uInt32 myConnectionAttempts{0};
     uInt32 myRetry{0};
+    bool myPipelined{true};
+    bool myEchoOff{true};
+    bool myDifferential{true};
+    bool myStaged{true};
+    bool myBlankCheck{true};
+    bool myEchoing{true};   // current echo state of the bootloader
+    uInt32 myWindowLines{MaxWindowLines};  // data lines per checksum
+    double myWindowsSent{0}, myWindowLinesSent{0}, myWindowErrors{0};  // decaying counts
+    uInt32 myMaxBaud{0}, myPreferredBaud{0}, myNegotiatedBaud{0};
     string myOscillator{"10000"};
 
+    FlashCache* myFlashCache{nullptr};
+    bool myRememberFlash{true};
+    IspSession mySession;
+    uInt32 myBootTime{0};         // ms from releasing reset to an answer
+    bool myBooting{false};        // reset released, bootloader starting up
+
+    // Timing for polling a freshly reset bootloader, in milliseconds
+    static constexpr uInt32 ourPollTime = 50, ourBootWindow = 600, ourMaxBootWindow = 2000;
+
+    // Encoded image, kept between downloads of the same image to the same part
+    TransferPlan myTransferPlan;
+    bool myRecordCommands{false};
+
     ostream* myLog{&cout};
 
   private:
@@ -0,0 +1,82 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+
+#include <QCryptographicHash>
+#include <QSettings>
+#include <QStringList>
+
+#include "FlashCache.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FlashCache::load(const string& port, uInt32 partID)
+{
+  // Path separators would otherwise create nested groups
+  myKey = QString::fromStdString(port) + "-" + QString::number(partID, 16);
+  myKey.replace('/', '_').replace('\\', '_');
+
+  myHashes.clear();
+
+  QSettings s;
+  s.beginGroup("FlashCache");
+    for(const auto& h: s.value(myKey).toStringList())
+      myHashes.emplace_back(h.toStdString());
+    myComplete = s.value(myKey + "-complete", true).toBool();
+  s.endGroup();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FlashCache::save() const
+{
+  QStringList hashes;
+  for(const auto& h: myHashes)
+    hashes.push_back(QString::fromStdString(h));
+
+  QSettings s;
+  s.beginGroup("FlashCache");
+    s.setValue(myKey, hashes);
+    s.setValue(myKey + "-complete", myComplete);
+  s.endGroup();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FlashCache::clear()
+{
+  myHashes.clear();
+  myComplete = true;
+
+  QSettings s;
+  s.beginGroup("FlashCache");
+    s.remove(myKey);
+    s.remove(myKey + "-complete");
+  s.endGroup();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FlashCache::setHash(uInt32 sector, const string& hash)
+{
+  if(sector >= myHashes.size())
+    myHashes.resize(sector + 1);
+
+  myHashes[sector] = hash;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string FlashCache::hash(const uInt8* data, size_t size)
+{
+  const QByteArray bytes = QByteArray::fromRawData(
+      reinterpret_cast<const char*>(data), static_cast<int>(size));
+
+  return QCryptographicHash::hash(bytes, QCryptographicHash::Sha1).toHex().toStdString();
+}
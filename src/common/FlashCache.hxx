@@ -0,0 +1,101 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+
+#ifndef FLASH_CACHE_HXX
+#define FLASH_CACHE_HXX
+
+#include <QString>
+
+#include "bspf.hxx"
+
+/**
+  Remembers what was last written to the flash of each cart, as a hash per
+  flash sector.  Entries are keyed by the serial port the cart is connected
+  to and its part ID, and are kept in the application settings, so they
+  survive between sessions.
+
+  A sector whose hash matches the data about to be written doesn't need to
+  be sent to the cart at all.  Since the flash can be changed behind our
+  back (by another machine, or another program), callers are expected to
+  spot-check a sector before trusting an entry.
+
+  Sectors are recorded as they are programmed, so an entry also serves as
+  the journal of a download that didn't complete; such entries are marked
+  as incomplete until the download finishes.
+
+  @author  Stephen Anthony
+*/
+class FlashCache
+{
+  public:
+    FlashCache() = default;
+    ~FlashCache() = default;
+
+    /**
+      Load the entry for the given port and part ID, which then becomes
+      the current entry.
+    */
+    void load(const string& port, uInt32 partID);
+
+    /**
+      Write the current entry back to the settings.
+    */
+    void save() const;
+
+    /**
+      Forget everything in the current entry, and remove it from the
+      settings.
+    */
+    void clear();
+
+    /**
+      Answers whether the given sector is known to hold the given data.
+    */
+    bool matches(uInt32 sector, const string& hash) const {
+      return sector < myHashes.size() && !hash.empty() && myHashes[sector] == hash;
+    }
+
+    /**
+      Set the hash of the data in the given sector; an empty hash means the
+      contents are unknown.
+    */
+    void setHash(uInt32 sector, const string& hash);
+
+    /**
+      Answers whether the current entry was written by a download that
+      completed, rather than one that failed or was cancelled.
+    */
+    bool complete() const { return myComplete; }
+    void setComplete(bool complete) { myComplete = complete; }
+
+    /**
+      Calculate the hash used to identify the contents of a sector.
+    */
+    static string hash(const uInt8* data, size_t size);
+
+  private:
+    QString myKey;
+    StringList myHashes;
+    bool myComplete{true};
+
+  private:
+    // Following constructors and assignment operators not supported
+    FlashCache(const FlashCache&) = delete;
+    FlashCache(FlashCache&&) = delete;
+    FlashCache& operator=(const FlashCache&) = delete;
+    FlashCache& operator=(FlashCache&&) = delete;
+};
+
+#endif
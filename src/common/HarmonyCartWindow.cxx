@@ -131,12 +131,35 @@ void HarmonyCartWindow::setupConnections()
   group2->addAction(ui->actionRetry20);
   connect(group2, SIGNAL(triggered(QAction*)), this, SLOT(slotRetry(QAction*)));
 
+  QActionGroup* group3 = new QActionGroup(this);
+  group3->setExclusive(true);
+  group3->addAction(ui->actionBaud38400);
+  group3->addAction(ui->actionBaud115200);
+  group3->addAction(ui->actionBaud230400);
+  connect(group3, SIGNAL(triggered(QAction*)), this, SLOT(slotMaxBaud(QAction*)));
+
   connect(ui->actionShowLogAfterDownload, &QAction::toggled, this,
       [=, this](bool checked){ showLog(checked); });
   connect(ui->actionF4CompressionNoBank0, &QAction::toggled, this,
       [=, this](bool checked){ myCart.skipF4CompressionOnBank0(checked); });
   connect(ui->actionAddDelayAfterWrites, &QAction::toggled, this,
       [=, this](bool checked){ myManager.port().addDelayAfterWrite(checked); });
+  connect(ui->actionLowLatency, &QAction::toggled, this,
+      [=, this](bool checked){ myManager.port().setLowLatency(checked); });
+  connect(ui->actionThreadedIO, &QAction::toggled, this,
+      [=, this](bool checked){ myManager.setThreadedIO(checked); });
+  connect(ui->actionPipelinedTransfer, &QAction::toggled, this,
+      [=, this](bool checked){ myCart.setPipelinedTransfer(checked); });
+  connect(ui->actionEchoOff, &QAction::toggled, this,
+      [=, this](bool checked){ myCart.setEchoOff(checked); });
+  connect(ui->actionDifferentialDownload, &QAction::toggled, this,
+      [=, this](bool checked){ myCart.setDifferentialDownload(checked); });
+  connect(ui->actionFlashCache, &QAction::toggled, this,
+      [=, this](bool checked){ myCart.setFlashCacheEnabled(checked); });
+  connect(ui->actionStagedTransfer, &QAction::toggled, this,
+      [=, this](bool checked){ myCart.setStagedTransfer(checked); });
+  connect(ui->actionBlankCheck, &QAction::toggled, this,
+      [=, this](bool checked){ myCart.setBlankCheck(checked); });
 
   // Help menu
   connect(ui->actAbout, SIGNAL(triggered()), this, SLOT(slotAbout()));
@@ -198,6 +221,7 @@ void HarmonyCartWindow::readSettings()
 
   s.beginGroup("MainWindow");
     myManager.setDefaultPort(s.value("harmonyport", "").toString().toStdString());
+    myManager.setConnectionBaud(s.value("connectionbaud", SerialPortManager::ourISPBaud).toUInt());
     int connections = s.value("connectionattempts", 5).toInt();
     switch(connections)
     {
@@ -214,11 +238,26 @@ void HarmonyCartWindow::readSettings()
       case 20:  ui->actionRetry20->setChecked(true); break;
       default: ui->actionRetry1->setChecked(true);   break;
     }
+    int maxbaud = s.value("maxbaud", 230400).toInt();
+    switch(maxbaud)
+    {
+      case  38400: ui->actionBaud38400->setChecked(true);  break;
+      case 115200: ui->actionBaud115200->setChecked(true); break;
+      default:     ui->actionBaud230400->setChecked(true); maxbaud = 230400; break;
+    }
     ui->actionAutoDownFileSelect->setChecked(s.value("autodownload", false).toBool());
     ui->actionAutoVerifyDownload->setChecked(s.value("autoverify", false).toBool());
     ui->actionShowLogAfterDownload->setChecked(s.value("showlog", false).toBool());
     ui->actionF4CompressionNoBank0->setChecked(s.value("f4compressbank0skip", false).toBool());
     ui->actionAddDelayAfterWrites->setChecked(s.value("delayafterwrites", false).toBool());
+    ui->actionLowLatency->setChecked(s.value("lowlatency", true).toBool());
+    ui->actionThreadedIO->setChecked(s.value("threadedio", false).toBool());
+    ui->actionPipelinedTransfer->setChecked(s.value("pipelinedtransfer", true).toBool());
+    ui->actionEchoOff->setChecked(s.value("echooff", true).toBool());
+    ui->actionDifferentialDownload->setChecked(s.value("differential", true).toBool());
+    ui->actionFlashCache->setChecked(s.value("flashcache", true).toBool());
+    ui->actionStagedTransfer->setChecked(s.value("stagedtransfer", true).toBool());
+    ui->actionBlankCheck->setChecked(s.value("blankcheck", true).toBool());
     ui->actionContinueOnFatalErrors->setChecked(s.value("continueonfatal", false).toBool());
     int activetab = s.value("activetab", 0).toInt();
     if(activetab < 0 || activetab > 1)  activetab = 0;
@@ -227,8 +266,17 @@ void HarmonyCartWindow::readSettings()
 
   showLog(ui->actionShowLogAfterDownload->isChecked());
   myManager.port().addDelayAfterWrite(ui->actionAddDelayAfterWrites->isChecked());
+  myManager.port().setLowLatency(ui->actionLowLatency->isChecked());
+  myManager.setThreadedIO(ui->actionThreadedIO->isChecked());
+  myCart.setPipelinedTransfer(ui->actionPipelinedTransfer->isChecked());
+  myCart.setEchoOff(ui->actionEchoOff->isChecked());
+  myCart.setDifferentialDownload(ui->actionDifferentialDownload->isChecked());
+  myCart.setFlashCacheEnabled(ui->actionFlashCache->isChecked());
+  myCart.setStagedTransfer(ui->actionStagedTransfer->isChecked());
+  myCart.setBlankCheck(ui->actionBlankCheck->isChecked());
   myCart.setConnectionAttempts(connections);
   myCart.setRetry(retrycount);
+  myCart.setMaxBaud(maxbaud);
 
   s.beginGroup("QPButtons");
     assignToQPButton(ui->qp1Button, 1, s.value("button1", "").toString(), false);
@@ -293,6 +341,7 @@ void HarmonyCartWindow::closeEvent(QCloseEvent* event)
 
   s.beginGroup("MainWindow");
     s.setValue("harmonyport", QString(myManager.portName().c_str()));
+    s.setValue("connectionbaud", myManager.connectionBaud());
     int connections = 5;
     if(ui->actionConnect5->isChecked())         connections = 5;
     else if(ui->actionConnect20->isChecked())   connections = 20;
@@ -303,11 +352,23 @@ void HarmonyCartWindow::closeEvent(QCloseEvent* event)
     else if(ui->actionRetry5->isChecked())  retrycount = 5;
     else if(ui->actionRetry20->isChecked()) retrycount = 20;
     s.setValue("retrycount", retrycount);
+    int maxbaud = 230400;
+    if(ui->actionBaud38400->isChecked())       maxbaud = 38400;
+    else if(ui->actionBaud115200->isChecked()) maxbaud = 115200;
+    s.setValue("maxbaud", maxbaud);
     s.setValue("autodownload", ui->actionAutoDownFileSelect->isChecked());
     s.setValue("autoverify", ui->actionAutoVerifyDownload->isChecked());
     s.setValue("showlog", ui->actionShowLogAfterDownload->isChecked());
     s.setValue("f4compressbank0skip", ui->actionF4CompressionNoBank0->isChecked());
     s.setValue("delayafterwrites", ui->actionAddDelayAfterWrites->isChecked());
+    s.setValue("lowlatency", ui->actionLowLatency->isChecked());
+    s.setValue("threadedio", ui->actionThreadedIO->isChecked());
+    s.setValue("pipelinedtransfer", ui->actionPipelinedTransfer->isChecked());
+    s.setValue("echooff", ui->actionEchoOff->isChecked());
+    s.setValue("differential", ui->actionDifferentialDownload->isChecked());
+    s.setValue("flashcache", ui->actionFlashCache->isChecked());
+    s.setValue("stagedtransfer", ui->actionStagedTransfer->isChecked());
+    s.setValue("blankcheck", ui->actionBlankCheck->isChecked());
     s.setValue("continueonfatal", ui->actionContinueOnFatalErrors->isChecked());
     s.setValue("activetab", ui->tabWidget->currentIndex());
   s.endGroup();
@@ -377,7 +438,7 @@ void HarmonyCartWindow::slotDownloadBIOS()
   myDownloadInProgress = true;
   ui->updateBIOSButton->setEnabled(!myDownloadInProgress);
 
-  if(myManager.openCartPort())
+  if(myManager.openCartPort(myCart))
   {
     myLog.str("");
     string result = myCart.downloadBIOS(myManager.port(), biosfile.toStdString(),
@@ -385,7 +446,7 @@ void HarmonyCartWindow::slotDownloadBIOS()
                     ui->actionContinueOnFatalErrors->isChecked());
     statusMessage(QString(result.c_str()));
 
-    myManager.closeCartPort();
+    myManager.closeCartPort(myCart);
 
     if(ui->actionShowLogAfterDownload->isChecked())
       QMessageBox::information(this, "Download BIOS", QString(myLog.str().c_str()));
@@ -448,7 +509,7 @@ void HarmonyCartWindow::slotDownloadROM()
   myDownloadInProgress = true;
   ui->downloadButton->setEnabled(!myDownloadInProgress);
 
-  if(myManager.openCartPort())
+  if(myManager.openCartPort(myCart))
   {
     const string& name = ui->romBSType->currentData().toString().toStdString();
     Bankswitch::Type type = Bankswitch::nameToType(name);
@@ -460,7 +521,7 @@ void HarmonyCartWindow::slotDownloadROM()
     statusMessage(QString(result.c_str()));
     ui->downloadButton->setEnabled(true);
 
-    myManager.closeCartPort();
+    myManager.closeCartPort(myCart);
 
     if(ui->actionShowLogAfterDownload->isChecked())
       QMessageBox::information(this, "Download ROM", QString(myLog.str().c_str()));
@@ -524,6 +585,14 @@ void HarmonyCartWindow::slotRetry(QAction* action)
   else                              myCart.setRetry(1);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void HarmonyCartWindow::slotMaxBaud(QAction* action)
+{
+  if(action == ui->actionBaud38400)       myCart.setMaxBaud(38400);
+  else if(action == ui->actionBaud115200) myCart.setMaxBaud(115200);
+  else                                    myCart.setMaxBaud(230400);
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void HarmonyCartWindow::slotAbout()
 {
@@ -81,6 +81,7 @@ Q_OBJECT
     void slotOpenROM();
     void slotConnectAttempt(QAction* action);
     void slotRetry(QAction* action);
+    void slotMaxBaud(QAction* action);
     void slotAbout();
     void slotShowDefaultMsg();
 
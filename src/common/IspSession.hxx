@@ -0,0 +1,80 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef ISP_SESSION_HXX
+#define ISP_SESSION_HXX
+
+class SerialPort;
+
+#include "bspf.hxx"
+
+/**
+  A connection to the bootloader that has been synchronized, unlocked and
+  identified, and is kept open between operations.  Detecting the cart,
+  downloading and reading flash all share it, so only the first of them
+  has to reset the cart and go through the whole handshake; the others
+  just revalidate it with a single command.
+
+  The session only records what is known about the other end of a port.
+  It ends as soon as that can't be relied on any more: when the port is
+  closed, when the target is reset or starts running code, or when a
+  command fails.
+
+  @author  Stephen Anthony
+*/
+class IspSession
+{
+  public:
+    IspSession() = default;
+    ~IspSession() = default;
+
+    /**
+      Start a session on the given port, with the given device (an index
+      into the table of known parts), synchronized at the given rate.
+    */
+    void start(const SerialPort& port, uInt32 device, uInt32 syncBaud) {
+      myPort = &port;
+      myDevice = device;
+      mySyncBaud = syncBaud;
+    }
+
+    /** End the session; the next operation starts from scratch. */
+    void end() { myPort = nullptr; }
+
+    /** Answers whether a session is open on the given port. */
+    bool activeOn(const SerialPort& port) const { return myPort == &port; }
+
+    /** The device identified when the session started. */
+    uInt32 device() const { return myDevice; }
+
+    /**
+      The rate the bootloader was synchronized at; the link may have moved
+      to a faster one since.
+    */
+    uInt32 syncBaud() const { return mySyncBaud; }
+
+  private:
+    const SerialPort* myPort{nullptr};
+    uInt32 myDevice{0};
+    uInt32 mySyncBaud{0};
+
+  private:
+    // Following constructors and assignment operators not supported
+    IspSession(const IspSession&) = delete;
+    IspSession(IspSession&&) = delete;
+    IspSession& operator=(const IspSession&) = delete;
+    IspSession& operator=(IspSession&&) = delete;
+};
+
+#endif
@@ -0,0 +1,489 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include "CartProgrammer.hxx"
+#include "LpcIspEmulator.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool LpcIspEmulator::Config::setPart(const string& product)
+{
+  uInt32 ramKB = 0;
+  if(!CartProgrammer::deviceLayout(product, partId, partId2, sectorTable, ramKB))
+    return false;
+
+  ramSize = static_cast<uInt32>(ramKB * 1_KB);
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+LpcIspEmulator::LpcIspEmulator(const Config& config)
+  : myConfig{config}
+{
+  uInt32 flashSize = 0;
+  for(auto size: myConfig.sectorTable)
+    flashSize += size;
+
+  myFlash.resize(flashSize, 0xFF);
+  myRam.resize(myConfig.ramSize, 0x00);
+  myPrepared.resize(myConfig.sectorTable.size(), false);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void LpcIspEmulator::reset()
+{
+  myState = State::Autobaud;
+  myLine.clear();
+  myEcho = true;
+  myUnlocked = false;
+  myRequestedBaud = 0;
+  std::fill(myPrepared.begin(), myPrepared.end(), false);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 LpcIspEmulator::receive(uInt8 c, string& out)
+{
+  switch(myState)
+  {
+    case State::Running:
+      return 0;
+
+    case State::Autobaud:
+      if(c == '?')
+      {
+        out += "Synchronized\r\n";
+        myState = State::SyncString;
+      }
+      return 0;
+
+    default:
+      break;
+  }
+
+  // Everything else is line-based, with the bootloader echoing each
+  // character as it arrives (unless echo was turned off with 'A 0')
+  if(myEcho)
+    out += static_cast<char>(c);
+  if(c == '\r')
+    return 0;
+  else if(c != '\n')
+  {
+    myLine += static_cast<char>(c);
+    return 0;
+  }
+
+  const string line = myLine;
+  myLine.clear();
+
+  switch(myState)
+  {
+    case State::SyncString:
+      if(line == "Synchronized")
+      {
+        out += "OK\r\n";
+        myState = State::Oscillator;
+      }
+      else
+        myState = State::Autobaud;
+      break;
+
+    case State::Oscillator:
+      out += "OK\r\n";
+      myState = State::Command;
+      break;
+
+    case State::Command:
+      return handleCommand(line, out);
+
+    case State::WriteData:
+    {
+      // Uuencoded line; the first character holds the number of bytes
+      if(line.empty())
+        break;
+      const uInt32 len = (line[0] - 0x20) & 0x3F;
+      uInt32 bytes = 0;
+      for(size_t i = 1; i + 3 < line.size() && bytes < len; i += 4)
+      {
+        uInt32 k = 0;
+        for(size_t j = 0; j < 4; ++j)
+          k = (k << 6) | ((line[i + j] - 0x20) & 0x3F);
+        for(int shift = 16; shift >= 0 && bytes < len; shift -= 8, ++bytes)
+        {
+          const uInt8 b = (k >> shift) & 0xFF;
+          if(myXferPos < myXferSize)
+            myRam[myXferAddr - myConfig.ramStart + myXferPos++] = b;
+          myWindowSum += b;
+        }
+      }
+      if(++myWindowLines == 20 || myXferPos >= myXferSize)
+        myState = State::WriteChecksum;
+      break;
+    }
+
+    case State::WriteChecksum:
+    {
+      if(static_cast<uInt32>(strtoul(line.c_str(), nullptr, 10)) == myWindowSum)
+      {
+        out += "OK\r\n";
+        myWindowStart = myXferPos;
+        myState = myXferPos < myXferSize ? State::WriteData : State::Command;
+      }
+      else
+      {
+        out += "RESEND\r\n";
+        myXferPos = myWindowStart;
+        myState = State::WriteData;
+      }
+      myWindowLines = myWindowSum = 0;
+      break;
+    }
+
+    case State::ReadAck:
+      if(line == "OK")
+      {
+        if(myXferPos < myXferSize)
+          sendReadWindow(out);
+        else
+          myState = State::Command;
+      }
+      else if(line == "RESEND")
+      {
+        myXferPos = myWindowStart;
+        sendReadWindow(out);
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 LpcIspEmulator::handleCommand(const string& line, string& out)
+{
+  auto status = [&out](uInt32 code) { out += std::to_string(code) + "\r\n"; };
+
+  istringstream buf(line);
+  string cmd;
+  buf >> cmd;
+  uInt32 arg[3] = { 0, 0, 0 };
+  string mode;
+  int args = 0;
+  while(args < 3 && (buf >> arg[args]))
+    ++args;
+  if(args < 3)
+  {
+    buf.clear();
+    buf >> mode;
+  }
+
+  auto validSectors = [&]() {
+    return args >= 2 && arg[0] <= arg[1] && arg[1] < myPrepared.size();
+  };
+
+  if(cmd == "U")
+  {
+    myUnlocked = args == 1 && arg[0] == 23130;
+    status(myUnlocked ? CMD_SUCCESS : INVALID_CODE);
+  }
+  else if(cmd == "A")
+  {
+    if(args != 1 || arg[0] > 1)
+      status(PARAM_ERROR);
+    else
+    {
+      status(CMD_SUCCESS);
+      myEcho = arg[0] == 1;
+    }
+  }
+  else if(cmd == "B")
+  {
+    static constexpr std::array<uInt32, 6> rates = {
+      9600, 19200, 38400, 57600, 115200, 230400
+    };
+    if(args != 2 || !BSPF::contains(rates, arg[0]))
+      status(INVALID_BAUD_RATE);
+    else if(arg[1] != 1 && arg[1] != 2)
+      status(INVALID_STOP_BIT);
+    else
+    {
+      status(CMD_SUCCESS);
+      myRequestedBaud = arg[0];
+    }
+  }
+  else if(cmd == "K")
+  {
+    status(CMD_SUCCESS);
+    out += std::to_string(myConfig.bootVersionMinor) + "\r\n" +
+           std::to_string(myConfig.bootVersionMajor) + "\r\n";
+  }
+  else if(cmd == "J")
+  {
+    status(CMD_SUCCESS);
+    out += std::to_string(myConfig.partId) + "\r\n";
+    if(myConfig.partId2 != 0)
+      out += std::to_string(myConfig.partId2) + "\r\n";
+  }
+  else if(cmd == "P")
+  {
+    if(!validSectors())
+      status(INVALID_SECTOR);
+    else
+    {
+      for(uInt32 s = arg[0]; s <= arg[1]; ++s)
+        myPrepared[s] = true;
+      status(CMD_SUCCESS);
+    }
+  }
+  else if(cmd == "E")
+  {
+    if(!myUnlocked)
+      status(CMD_LOCKED);
+    else if(!validSectors())
+      status(INVALID_SECTOR);
+    else
+    {
+      for(uInt32 s = arg[0]; s <= arg[1]; ++s)
+      {
+        if(!myPrepared[s])
+        {
+          status(SECTOR_NOT_PREPARED_FOR_WRITE_OPERATION);
+          return 0;
+        }
+      }
+      for(uInt32 s = arg[0]; s <= arg[1]; ++s)
+      {
+        std::fill_n(myFlash.begin() + sectorStart(s), myConfig.sectorTable[s], 0xFF);
+        myPrepared[s] = false;
+      }
+      ++myEraseCount;
+      status(CMD_SUCCESS);
+      return myConfig.eraseMicros + myConfig.eraseSectorMicros * (arg[1] - arg[0] + 1);
+    }
+  }
+  else if(cmd == "I")
+  {
+    if(!validSectors())
+      status(INVALID_SECTOR);
+    else
+    {
+      const uInt32 end = sectorStart(arg[1]) + myConfig.sectorTable[arg[1]];
+      for(uInt32 addr = sectorStart(arg[0]); addr < end; addr += 4)
+      {
+        const uInt32 word = readByte(addr) | (readByte(addr+1) << 8) |
+                            (readByte(addr+2) << 16) | (readByte(addr+3) << 24);
+        if(word != 0xFFFFFFFF)
+        {
+          status(SECTOR_NOT_BLANK);
+          out += std::to_string(addr) + "\r\n" + std::to_string(word) + "\r\n";
+          return 0;
+        }
+      }
+      status(CMD_SUCCESS);
+    }
+  }
+  else if(cmd == "W")
+  {
+    if(!myUnlocked)
+      status(CMD_LOCKED);
+    else if(args != 2 || arg[0] % 4 != 0)
+      status(args != 2 ? PARAM_ERROR : DST_ADDR_ERROR);
+    else if(arg[1] % 4 != 0)
+      status(COUNT_ERROR);
+    else if(!isRam(arg[0], arg[1]))
+      status(DST_ADDR_NOT_MAPPED);
+    else
+    {
+      status(CMD_SUCCESS);
+      myXferAddr = arg[0];  myXferSize = arg[1];
+      myXferPos = myWindowStart = myWindowLines = myWindowSum = 0;
+      myState = myXferSize > 0 ? State::WriteData : State::Command;
+    }
+  }
+  else if(cmd == "R")
+  {
+    if(args != 2 || arg[0] % 4 != 0)
+      status(args != 2 ? PARAM_ERROR : SRC_ADDR_ERROR);
+    else if(arg[1] % 4 != 0)
+      status(COUNT_ERROR);
+    else if(!isRam(arg[0], arg[1]) && !isFlash(arg[0], arg[1]))
+      status(SRC_ADDR_NOT_MAPPED);
+    else
+    {
+      status(CMD_SUCCESS);
+      myXferAddr = arg[0];  myXferSize = arg[1];
+      myXferPos = 0;
+      if(myXferSize > 0)
+        sendReadWindow(out);
+    }
+  }
+  else if(cmd == "C")
+  {
+    static constexpr std::array<uInt32, 5> sizes = { 256, 512, 1024, 4096, 8192 };
+    if(!myUnlocked)
+      status(CMD_LOCKED);
+    else if(args != 3)
+      status(PARAM_ERROR);
+    else if(arg[0] % 256 != 0)
+      status(DST_ADDR_ERROR);
+    else if(!isFlash(arg[0], arg[2]))
+      status(DST_ADDR_NOT_MAPPED);
+    else if(arg[1] % 4 != 0)
+      status(SRC_ADDR_ERROR);
+    else if(!isRam(arg[1], arg[2]))
+      status(SRC_ADDR_NOT_MAPPED);
+    else if(!BSPF::contains(sizes, arg[2]))
+      status(COUNT_ERROR);
+    else
+    {
+      const uInt32 first = sectorOf(arg[0]), last = sectorOf(arg[0] + arg[2] - 1);
+      for(uInt32 s = first; s <= last; ++s)
+      {
+        if(!myPrepared[s])
+        {
+          status(SECTOR_NOT_PREPARED_FOR_WRITE_OPERATION);
+          return 0;
+        }
+      }
+      // Flash programming can only clear bits
+      for(uInt32 i = 0; i < arg[2]; ++i)
+        myFlash[arg[0] + i] &= myRam[arg[1] - myConfig.ramStart + i];
+      for(uInt32 s = first; s <= last; ++s)
+        myPrepared[s] = false;
+      ++myCopyCount;
+      status(CMD_SUCCESS);
+      return myConfig.copyMicros * (arg[2] / 256);
+    }
+  }
+  else if(cmd == "M")
+  {
+    if(args != 3)
+      status(PARAM_ERROR);
+    else if(arg[0] % 4 != 0 || arg[1] % 4 != 0)
+      status(ADDR_ERROR);
+    else if(arg[2] % 4 != 0)
+      status(COUNT_ERROR);
+    else
+    {
+      for(uInt32 i = 0; i < arg[2]; ++i)
+      {
+        if(readByte(arg[0] + i) != readByte(arg[1] + i))
+        {
+          status(COMPARE_ERROR);
+          out += std::to_string(i & ~3u) + "\r\n";
+          return 0;
+        }
+      }
+      status(CMD_SUCCESS);
+    }
+  }
+  else if(cmd == "G")
+  {
+    if(!myUnlocked)
+      status(CMD_LOCKED);
+    else if(args != 1 || (mode != "A" && mode != "T"))
+      status(PARAM_ERROR);
+    else
+    {
+      status(CMD_SUCCESS);
+      myState = State::Running;
+    }
+  }
+  else
+    status(INVALID_COMMAND);
+
+  return 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void LpcIspEmulator::sendReadWindow(string& out)
+{
+  static constexpr char uuencode_table[] =
+    "`!\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_";
+
+  myWindowStart = myXferPos;
+  uInt32 sum = 0;
+  for(int line = 0; line < 20 && myXferPos < myXferSize; ++line)
+  {
+    const uInt32 len = std::min<uInt32>(45, myXferSize - myXferPos);
+    out += static_cast<char>(0x20 + len);
+    for(uInt32 i = 0; i < len; i += 3)
+    {
+      uInt32 k = 0;
+      for(uInt32 j = 0; j < 3; ++j)
+      {
+        const uInt8 b = (i + j < len) ? readByte(myXferAddr + myXferPos + i + j) : 0;
+        if(i + j < len)
+          sum += b;
+        k = (k << 8) | b;
+      }
+      out += uuencode_table[(k >> 18) & 63];
+      out += uuencode_table[(k >> 12) & 63];
+      out += uuencode_table[(k >>  6) & 63];
+      out += uuencode_table[ k        & 63];
+    }
+    out += "\r\n";
+    myXferPos += len;
+  }
+  out += std::to_string(sum) + "\r\n";
+  myState = State::ReadAck;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool LpcIspEmulator::isFlash(uInt32 addr, uInt32 size) const
+{
+  return static_cast<uInt64>(addr) + size <= myFlash.size();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool LpcIspEmulator::isRam(uInt32 addr, uInt32 size) const
+{
+  return addr >= myConfig.ramStart &&
+         static_cast<uInt64>(addr) + size <= myConfig.ramStart + myRam.size();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt8 LpcIspEmulator::readByte(uInt32 addr) const
+{
+  // The first 64 bytes of flash are remapped to the boot block while
+  // the bootloader is running
+  if(addr < 64)
+    return static_cast<uInt8>(0xA5 ^ addr);
+  else if(addr < myFlash.size())
+    return myFlash[addr];
+  else if(isRam(addr, 1))
+    return myRam[addr - myConfig.ramStart];
+  else
+    return 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 LpcIspEmulator::sectorOf(uInt32 addr) const
+{
+  uInt32 sector = 0, start = 0;
+  while(sector < myConfig.sectorTable.size() - 1 &&
+        addr >= start + myConfig.sectorTable[sector])
+    start += myConfig.sectorTable[sector++];
+  return sector;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 LpcIspEmulator::sectorStart(uInt32 sector) const
+{
+  uInt32 start = 0;
+  for(uInt32 s = 0; s < sector; ++s)
+    start += myConfig.sectorTable[s];
+  return start;
+}
@@ -0,0 +1,146 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef LPC_ISP_EMULATOR_HXX
+#define LPC_ISP_EMULATOR_HXX
+
+#include "bspf.hxx"
+
+/**
+  Emulates the serial ISP bootloader found in the NXP LPC2xxx family, as
+  spoken to by CartProgrammer.  Bytes sent by the host are fed in one at a
+  time, and any bytes the bootloader would send back are appended to an
+  output string.
+
+  This class has no notion of time or of the serial line itself; it only
+  reports how long each command would keep the chip busy, and leaves the
+  line model to the caller (see SerialPortSimulated).
+
+  @author  Stephen Anthony
+*/
+class LpcIspEmulator
+{
+  public:
+    struct Config
+    {
+      uInt32 partId{0x0004FF11};       // LPC2103, as used in the Harmony cart
+      uInt32 partId2{0};               // second ID word, for parts that have one
+      uIntArray sectorTable{uIntArray(8, 4096)};
+      uInt32 ramStart{0x40000000};
+      uInt32 ramSize{8_KB};
+      uInt32 bootVersionMajor{2};
+      uInt32 bootVersionMinor{11};
+      uInt32 eraseMicros{100000};      // fixed cost of each 'E' command
+      uInt32 eraseSectorMicros{5000};  // additional cost per erased sector
+      uInt32 copyMicros{1000};         // cost of each 'C' command, per 256 bytes
+
+      /**
+        Take the part ID and memory layout from the device table used by
+        CartProgrammer.  Only LPC2xxx parts are supported.
+
+        @param product  The product name of the part (e.g. "2103")
+        @return  False if the part is unknown or not supported
+      */
+      bool setPart(const string& product);
+    };
+
+  public:
+    explicit LpcIspEmulator(const Config& config);
+    ~LpcIspEmulator() = default;
+
+    /**
+      Hardware reset with the ISP line asserted; the bootloader restarts
+      and waits for the autobaud '?' character.
+    */
+    void reset();
+
+    /**
+      Process one byte received from the host.
+
+      @param c    The byte received
+      @param out  Bytes sent back to the host are appended here
+      @return  Time in microseconds the bootloader is busy before the
+               response (if any) is sent
+    */
+    uInt32 receive(uInt8 c, string& out);
+
+    /**
+      Baud rate requested by the last successful 'B' command, or 0 if
+      no such command has been issued since the last reset.
+    */
+    uInt32 requestedBaud() const { return myRequestedBaud; }
+
+    /** Answers whether the bootloader has handed control to user code. */
+    bool running() const { return myState == State::Running; }
+
+    /** Direct access to the emulated flash contents. */
+    ByteArray& flash() { return myFlash; }
+
+    /** Number of 'E' and 'C' commands executed since construction. */
+    uInt32 eraseCount() const { return myEraseCount; }
+    uInt32 copyCount() const  { return myCopyCount;  }
+
+  private:
+    enum class State {
+      Autobaud, SyncString, Oscillator, Command,
+      WriteData, WriteChecksum, ReadAck, Running
+    };
+
+    // Return codes used by the LPC ISP command handler
+    enum {
+      CMD_SUCCESS = 0, INVALID_COMMAND = 1, SRC_ADDR_ERROR = 2,
+      DST_ADDR_ERROR = 3, SRC_ADDR_NOT_MAPPED = 4, DST_ADDR_NOT_MAPPED = 5,
+      COUNT_ERROR = 6, INVALID_SECTOR = 7, SECTOR_NOT_BLANK = 8,
+      SECTOR_NOT_PREPARED_FOR_WRITE_OPERATION = 9, COMPARE_ERROR = 10,
+      PARAM_ERROR = 12, ADDR_ERROR = 13, CMD_LOCKED = 15,
+      INVALID_CODE = 16, INVALID_BAUD_RATE = 17, INVALID_STOP_BIT = 18
+    };
+
+    uInt32 handleCommand(const string& line, string& out);
+    void sendReadWindow(string& out);
+
+    bool isFlash(uInt32 addr, uInt32 size) const;
+    bool isRam(uInt32 addr, uInt32 size) const;
+    uInt8 readByte(uInt32 addr) const;
+    uInt32 sectorOf(uInt32 addr) const;
+    uInt32 sectorStart(uInt32 sector) const;
+
+  private:
+    Config myConfig;
+    State myState{State::Running};
+
+    ByteArray myFlash, myRam;
+    BoolArray myPrepared;
+
+    string myLine;
+    bool myEcho{true};
+    bool myUnlocked{false};
+    uInt32 myRequestedBaud{0};
+
+    // Transfer state for 'W' and 'R' commands
+    uInt32 myXferAddr{0}, myXferSize{0}, myXferPos{0};
+    uInt32 myWindowStart{0}, myWindowLines{0}, myWindowSum{0};
+
+    uInt32 myEraseCount{0}, myCopyCount{0};
+
+  private:
+    // Following constructors and assignment operators not supported
+    LpcIspEmulator() = delete;
+    LpcIspEmulator(const LpcIspEmulator&) = delete;
+    LpcIspEmulator(LpcIspEmulator&&) = delete;
+    LpcIspEmulator& operator=(const LpcIspEmulator&) = delete;
+    LpcIspEmulator& operator=(LpcIspEmulator&&) = delete;
+};
+
+#endif
@@ -0,0 +1,88 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef RX_BUFFER_HXX
+#define RX_BUFFER_HXX
+
+#include <cstring>
+
+#include "bspf.hxx"
+
+/**
+  Holds the bytes received on a serial port that haven't been handed to
+  the caller yet.  Data is read straight into the buffer, answers are
+  handed out as views into it, and whatever arrived after an answer just
+  stays where it is for the next one.  Unread data is only moved (back to
+  the front) when there's no longer enough room after it for a read, so
+  every view is contiguous.
+
+  @author  Stephen Anthony
+*/
+class RxBuffer
+{
+  public:
+    static constexpr size_t Capacity = 4096;
+
+    RxBuffer() = default;
+    ~RxBuffer() = default;
+
+    /** The unread data, and how much of it there is. */
+    const char* data() const { return myBuffer + myHead; }
+    size_t size() const { return myTail - myHead; }
+
+    /**
+      Make room for reading up to 'bytes' more bytes after the unread data.
+      This may move the unread data, invalidating views into it.
+
+      @return  Where to read the new data to
+    */
+    char* reserve(size_t bytes) {
+      if(myTail + bytes > Capacity && myHead > 0)
+      {
+        std::memmove(myBuffer, myBuffer + myHead, size());
+        myTail -= myHead;
+        myHead = 0;
+      }
+      return myBuffer + myTail;
+    }
+
+    /** Add 'bytes' bytes, just read to where reserve pointed, to the data. */
+    void commit(size_t bytes) { myTail += bytes; }
+
+    /**
+      Mark the first 'bytes' bytes of the data as handed out.  They stay
+      valid (for views into them) until the next call to reserve.
+    */
+    void consume(size_t bytes) {
+      myHead += bytes;
+      if(myHead == myTail)
+        myHead = myTail = 0;
+    }
+
+    /** Discard all unread data. */
+    void clear() { myHead = myTail = 0; }
+
+  private:
+    char myBuffer[Capacity];
+    size_t myHead{0}, myTail{0};
+
+  private:
+    // Following constructors and assignment operators not supported
+    RxBuffer(const RxBuffer&) = delete;
+    RxBuffer(RxBuffer&&) = delete;
+    RxBuffer& operator=(const RxBuffer&) = delete;
+    RxBuffer& operator=(RxBuffer&&) = delete;
+};
+
+#endif
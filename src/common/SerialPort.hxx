@@ -15,7 +15,10 @@
 #ifndef SERIAL_PORT_HXX
 #define SERIAL_PORT_HXX
 
+#include <span>
+
 #include "bspf.hxx"
+#include "RxBuffer.hxx"
 
 /**
   This class provides an interface for a standard serial port.
@@ -53,10 +56,8 @@ class SerialPort
 
     /**
       Sets (or resets) the timeout to the timout period requested.  Starts
-      counting to this period.  This timeout support is a little odd in that
-      the timeout specifies the accumulated deadtime waiting to read not the
-      total time waiting to read. They should be close enough to the same for
-      this use. Used by the serial input routines, the actual counting takes
+      counting to this period, which is a deadline for the total time waiting
+      to read.  Used by the serial input routines, the actual waiting takes
       place in receiveBlock.
 
       @param timeout_milliseconds  The time in milliseconds to use for timeout
@@ -66,7 +67,11 @@ class SerialPort
     /**
       Empty the serial port buffers.  Cleans things to a known state.
     */
-    virtual void clearBuffers() = 0;
+    void clearBuffers()
+    {
+      myRxBuffer.clear();
+      flushBuffers();
+    }
 
     /**
       Sleep the specified amount of time (in milliseconds).
@@ -78,6 +83,24 @@ class SerialPort
     */
     virtual const StringList& getPortNames() = 0;
 
+    // What's known about the hardware behind a port; anything that isn't
+    // known is left empty (or 0)
+    struct PortInfo
+    {
+      string description;                 // product name
+      string serialNumber;
+      uInt16 vendorID{0}, productID{0};   // USB IDs
+    };
+
+    /**
+      Get information about the given port, where the platform provides
+      it.  Ports found by the last call to getPortNames() are answered
+      without looking anything up again.
+
+      @return  The information, or nothing if this kind of port can't tell
+    */
+    virtual std::optional<PortInfo> portInfo(const string& device) { return {}; }
+
     /**
       Add a 100 ms delay after each block (makes lpc21isp to work with bad UARTs).
 
@@ -85,6 +108,15 @@ class SerialPort
     */
     void addDelayAfterWrite(bool delay) { myAddDelayAfterWrite = delay; }
 
+    /**
+      Ask the port driver to deliver received data as soon as it arrives,
+      instead of batching it (mainly a concern with USB serial adapters).
+      Takes effect the next time the port is opened.
+
+      @param enable  Whether to request low latency or not
+    */
+    void setLowLatency(bool enable) { myLowLatency = enable; }
+
     /**
       Utility function to write a string to the serial port, automatically
       determining the size of the block.
@@ -100,6 +132,37 @@ class SerialPort
       return result;
     }
 
+    /**
+      Write a string of known length to the serial port.
+
+      @param data  The string to write to the port
+      @return  The number of bytes written
+    */
+    size_t send(std::string_view data)
+    {
+      return data.empty() ? 0 : send(data.data(), data.size());
+    }
+
+    /**
+      Write several blocks of bytes to the serial port in one go, which
+      usually takes a single system call, and fewer USB packets than
+      sending them one at a time.  With a delay after writes, the blocks
+      are still sent (and followed by the delay) one at a time.
+
+      @param blocks  The blocks to write, in order
+      @return  The number of bytes written
+    */
+    size_t sendv(std::span<const std::string_view> blocks)
+    {
+      if(!myAddDelayAfterWrite)
+        return sendBlocks(blocks);
+
+      size_t result = 0;
+      for(auto block: blocks)
+        result += send(block);
+      return result;
+    }
+
     /**
       Receives a fixed block from the open com port. Returns when the
       block is completely filled or the timeout period has passed.
@@ -112,14 +175,20 @@ class SerialPort
     */
     size_t receiveCompleteBlock(void* block, size_t size, uInt32 timeout)
     {
-      size_t realsize = 0, read;
-      char* result = (char*)block;
+      char* result = static_cast<char*>(block);
+
+      // Anything left over from the last answer comes first
+      size_t realsize = std::min(size, myRxBuffer.size());
+      memcpy(result, myRxBuffer.data(), realsize);
+      myRxBuffer.consume(realsize);
 
       setTimeout(timeout);
-      do {
-        read = receiveBlock(result + realsize, size - realsize);
-        realsize += read;
-      } while ((realsize < size) && !timeoutCheck());
+      while (realsize < size)
+      {
+        realsize += receiveBlock(result + realsize, size - realsize);
+        if (timeoutCheck())
+          break;
+      }
 
       return realsize;
     }
@@ -149,81 +218,78 @@ class SerialPort
     size_t receive(const char* Ans, size_t MaxSize,
                    size_t WantedNr0x0A, uInt32 timeout)
     {
-      size_t tmp_realsize = 0;
-      uInt32 nr_of_0x0A = 0;
-      //uInt32 nr_of_0x0D = 0;
-      int eof = 0;
-      uInt8* Answer = (uInt8*) Ans;
-      uInt8* endPtr = nullptr;
-      static char residual_data[128] = {'\0'};
-      int lf = 0;
-      size_t RealSize = 0;
+      const std::string_view answer = receiveLines(WantedNr0x0A, timeout, MaxSize);
 
-      setTimeout(timeout);
+      char* Answer = const_cast<char*>(Ans);
+      memcpy(Answer, answer.data(), answer.size());
+      Answer[answer.size()] = '\0';
+      return answer.size();
+    }
+
+    /**
+      Receives from the open com port in the same way as receive(), but
+      without copying: the answer is a view into the receive buffer of the
+      port, which is only valid until the next call to one of the receive
+      methods.  Anything that arrived after the requested linefeeds stays
+      buffered for the next call.
+
+      @param Wanted   The maximum number of linefeeds to accept before
+                      returning
+      @param timeout  The maximum amount of time to wait before
+                      returning an incomplete answer (in milliseconds)
+      @param MaxSize  The maximum size of the answer
+      @return  The answer
+    */
+    std::string_view receiveLines(size_t WantedNr0x0A, uInt32 timeout,
+                                  size_t MaxSize = RxBuffer::Capacity)
+    {
+      MaxSize = std::min(MaxSize, RxBuffer::Capacity);
+      size_t scanned = 0, end = 0, nr_of_0x0A = 0;
+      bool lf = false, eof = false;
 
+      setTimeout(timeout);
       do
       {
-        if(residual_data[0] == '\0')
+        // Data left over from the last answer is scanned before reading more
+        if (scanned == myRxBuffer.size() && scanned < MaxSize)
         {
-          /* Receive new data */
-          tmp_realsize = receiveBlock(Answer + RealSize, MaxSize - RealSize);
-        }
-        else
-        {
-            /* Take over any old residual data */
-            strcpy((char *)Answer, residual_data);
-            tmp_realsize = strlen((char *)Answer);
-            residual_data[0] = '\0';
+          const size_t wanted = MaxSize - scanned;
+          myRxBuffer.commit(receiveBlock(myRxBuffer.reserve(wanted), wanted));
         }
 
-        if(tmp_realsize != 0)
+        const char* Answer = myRxBuffer.data();
+        for (; scanned < myRxBuffer.size() && scanned < MaxSize && end == 0; scanned++)
         {
-          for(size_t p = RealSize; p < RealSize + tmp_realsize; p++)
+          /* Torsten Lang 2013-05-06 Scan for 0x0d,0x0a,0x0a and 0x0d,0x0a as linefeed pattern */
+          if (Answer[scanned] == 0x0a)
           {
-            /* Torsten Lang 2013-05-06 Scan for 0x0d,0x0a,0x0a and 0x0d,0x0a as linefeed pattern */
-            if(Answer[p] == 0x0a)
-            {
-              if(lf != 0)
-              {
-                nr_of_0x0A++;
-                lf = 0;
-                if(nr_of_0x0A >= WantedNr0x0A)
-                  endPtr = &Answer[p+1];
-              }
-            }
-            else if(Answer[p] == 0x0d)
-            {
-              //nr_of_0x0D++;
-              lf = 1;
-            }
-            else if(((signed char) Answer[p]) < 0)
-            {
-              eof = 1;
-              lf  = 0;
-            }
-            else if (lf != 0)
+            if (lf)
             {
-              //nr_of_0x0D++;
-              nr_of_0x0A++;
-              lf = 0;
-              if(nr_of_0x0A >= WantedNr0x0A)
-                endPtr = &Answer[p+1];
+              lf = false;
+              if (++nr_of_0x0A >= WantedNr0x0A)
+                end = scanned + 1;
             }
           }
-          RealSize += tmp_realsize;
+          else if (Answer[scanned] == 0x0d)
+            lf = true;
+          else if (static_cast<signed char>(Answer[scanned]) < 0)
+          {
+            eof = true;
+            lf  = false;
+          }
+          else if (lf)
+          {
+            lf = false;
+            if (++nr_of_0x0A >= WantedNr0x0A)
+              end = scanned + 1;
+          }
         }
-      } while ((RealSize < MaxSize) && !timeoutCheck() && (nr_of_0x0A < WantedNr0x0A) && !eof);
+      } while (scanned < MaxSize && !timeoutCheck() && nr_of_0x0A < WantedNr0x0A && !eof);
 
-      /* Torsten Lang 2013-05-06 Store residual data and cut answer after expected nr. of 0x0a */
-      Answer[RealSize] = '\0';
-      if(endPtr != NULL)
-      {
-        strcpy(residual_data, (char *)endPtr);
-        *endPtr = '\0';
-        /* Torsten Lang 2013-06-28 Update size info */
-        RealSize = endPtr - Answer;
-      }
-      return RealSize;
+      /* Cut the answer after the expected nr. of 0x0a, the rest stays buffered */
+      const std::string_view answer(myRxBuffer.data(), end != 0 ? end : scanned);
+      myRxBuffer.consume(answer.size());
+      return answer;
     }
 
     /**
@@ -249,6 +315,22 @@ class SerialPort
     int getBaud() const    { return myBaud; }
     void setBaud(int baud) { myBaud = baud; }
 
+    /**
+      Change the baud rate of an already open port.  Any pending output is
+      sent at the old rate first.
+
+      @param baud  The new transfer rate for the port
+      @return  False if the rate isn't supported (the old rate stays in
+               effect), else true
+    */
+    virtual bool changeBaud(uInt32 baud) = 0;
+
+    /**
+      The baud rate the port actually runs at.  For rates the hardware
+      can't produce exactly, this is the closest one it can.
+    */
+    virtual uInt32 actualBaud() { return myBaud; }
+
     /**
       Get/set the control line swap for this port.
       Note that the port must be opened for this to take effect.
@@ -284,6 +366,26 @@ class SerialPort
     */
     virtual size_t sendBlock(const void* data, size_t size) = 0;
 
+    /**
+      Write several blocks of bytes to the serial port.  Unless a port can
+      do better, they're joined and written with a single sendBlock.
+
+      @param blocks  The blocks to write, in order
+      @return  The number of bytes written
+    */
+    virtual size_t sendBlocks(std::span<const std::string_view> blocks)
+    {
+      string data;
+      for(auto block: blocks)
+        data.append(block);
+      return sendBlock(data.data(), data.size());
+    }
+
+    /**
+      Empty the buffers of the serial port driver (and the UART).
+    */
+    virtual void flushBuffers() = 0;
+
     /**
       Check to see if the serial timeout timer has run down.
 
@@ -307,10 +409,19 @@ class SerialPort
     uInt32 myBaud{9600};
     uInt32 mySerialTimeoutCount{0};
     bool myAddDelayAfterWrite{false};
+    bool myLowLatency{false};
     bool myControlLinesSwapped{false};
     string myID;
     StringList myPortNames;
 
+  private:
+    // Received data not handed out yet
+    RxBuffer myRxBuffer;
+
+    // These pass calls on to the port they wrap
+    friend class SerialPortAsync;
+    friend class SerialPortCapture;
+
   private:
     // Following constructors and assignment operators not supported
     SerialPort(const SerialPort&) = delete;
@@ -0,0 +1,291 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include "SerialPortAsync.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+SerialPortAsync::SerialPortAsync(SerialPort& port)
+  : SerialPort(),
+    myPort{port}
+{
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+SerialPortAsync::~SerialPortAsync()
+{
+  stopThreads();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortAsync::openPort(const string& device)
+{
+  // Settings are made on this port, but the platform port applies them
+  myPort.setBaud(myBaud);
+  myPort.setControlSwap(myControlLinesSwapped);
+  myPort.setLowLatency(myLowLatency);
+  myPort.setID(myID);
+
+  if(!myPort.openPort(device))
+    return false;
+
+  if(myThreaded)
+    startThreads();
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::closePort()
+{
+  stopThreads();
+  myPort.closePort();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::setTimeout(uInt32 timeout_milliseconds)
+{
+  if(myRunning)
+    myDeadline = std::chrono::steady_clock::now() +
+                 std::chrono::milliseconds(timeout_milliseconds);
+  else
+    myPort.setTimeout(timeout_milliseconds);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortAsync::timeoutCheck()
+{
+  return myRunning ? std::chrono::steady_clock::now() >= myDeadline
+                   : myPort.timeoutCheck();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::controlModemLines(bool DTR, bool RTS)
+{
+  // Whatever was sent before a reset should reach the target before it
+  waitForSent();
+  myPort.controlModemLines(DTR, RTS);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::controlXonXoff(bool XonXoff)
+{
+  myPort.controlXonXoff(XonXoff);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortAsync::changeBaud(uInt32 baud)
+{
+  waitForSent();
+  if(!myPort.changeBaud(baud))
+    return false;
+
+  myBaud = baud;
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortAsync::receiveBlock(void* answer, size_t max_size)
+{
+  if(!myRunning)
+    return myPort.receiveBlock(answer, max_size);
+
+  std::unique_lock<std::mutex> lock(myMutex);
+  myRxReady.wait_until(lock, myDeadline, [this]{ return myRxRing.size() > 0; });
+  lock.unlock();
+
+  return myRxRing.pop(answer, max_size);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortAsync::sendBlock(const void* data, size_t size)
+{
+  if(!myRunning)
+    return myPort.sendBlock(data, size);
+
+  queue(data, size);
+  notifyWriter();
+  return size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortAsync::sendBlocks(std::span<const std::string_view> blocks)
+{
+  if(!myRunning)
+    return myPort.sendBlocks(blocks);
+
+  size_t size = 0;
+  for(auto block: blocks)
+  {
+    queue(block.data(), block.size());
+    size += block.size();
+  }
+  notifyWriter();
+  return size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::flushBuffers()
+{
+  if(!myRunning)
+  {
+    myPort.flushBuffers();
+    return;
+  }
+
+  // Nothing queued is thrown away, but anything received so far is
+  waitForSent();
+  std::lock_guard<std::mutex> lock(myReadMutex);
+  myPort.flushBuffers();
+  myRxRing.clear();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::startThreads()
+{
+  if(myRunning)
+    return;
+
+  myRunning = true;
+  myWriter = std::thread(&SerialPortAsync::writerLoop, this);
+  myReader = std::thread(&SerialPortAsync::readerLoop, this);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::stopThreads()
+{
+  if(!myRunning)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(myMutex);
+    myRunning = false;
+  }
+  myTxReady.notify_all();
+  myTxDone.notify_all();
+  myWriter.join();
+  myReader.join();
+
+  // As with closing any port, data not sent or not picked up is dropped;
+  // with the threads gone, this side can empty both rings
+  char discard[256];
+  while(myTxRing.pop(discard, sizeof(discard)) > 0)
+    ;
+  myRxRing.clear();
+  myTxQueued = myTxWritten = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::queue(const void* data, size_t size)
+{
+  const char* bytes = static_cast<const char*>(data);
+  for(size_t queued = 0; queued < size; )
+  {
+    const size_t added = myTxRing.push(bytes + queued, size - queued);
+    queued += added;
+    myTxQueued += added;
+
+    // The ring is full; wait for the writer to make room
+    if(queued < size)
+    {
+      notifyWriter();
+      std::unique_lock<std::mutex> lock(myMutex);
+      myTxDone.wait(lock, [&]{ return !myRunning || myTxWritten == myTxQueued; });
+      if(!myRunning)
+        return;
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::notifyWriter()
+{
+  // Taking the lock makes sure the writer is either before its check for
+  // data, or already waiting for this notification
+  { std::lock_guard<std::mutex> lock(myMutex); }
+  myTxReady.notify_one();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::waitForSent()
+{
+  if(!myRunning)
+    return;
+
+  std::unique_lock<std::mutex> lock(myMutex);
+  myTxDone.wait(lock, [this]{ return !myRunning || myTxWritten == myTxQueued; });
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::writerLoop()
+{
+  char chunk[4096];
+  for(;;)
+  {
+    const size_t size = myTxRing.pop(chunk, sizeof(chunk));
+    if(size == 0)
+    {
+      std::unique_lock<std::mutex> lock(myMutex);
+      if(!myRunning)
+        break;
+      myTxReady.wait(lock, [this]{ return !myRunning || myTxRing.size() > 0; });
+      continue;
+    }
+
+    // A failed write loses the rest of the chunk; the next answer from
+    // the target will show that something went wrong
+    for(size_t written = 0; written < size; )
+    {
+      const size_t n = myPort.sendBlock(chunk + written, size - written);
+      if(n == 0)
+        break;
+      written += n;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(myMutex);
+      myTxWritten += size;
+    }
+    myTxDone.notify_all();
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortAsync::readerLoop()
+{
+  char chunk[4096];
+  while(myRunning)
+  {
+    size_t size = 0;
+    bool failed = false;
+    {
+      std::lock_guard<std::mutex> lock(myReadMutex);
+
+      // Wait in short steps, so that stopping the thread doesn't take long
+      myPort.setTimeout(20);
+      size = myPort.receiveBlock(chunk, sizeof(chunk));
+      failed = size == 0 && !myPort.timeoutCheck();
+
+      // Nobody is picking up what was received if the ring is full, so
+      // what doesn't fit can be dropped
+      myRxRing.push(chunk, size);
+    }
+
+    if(size > 0)
+    {
+      { std::lock_guard<std::mutex> lock(myMutex); }
+      myRxReady.notify_all();
+    }
+    else if(failed)  // don't spin on a port that has gone away
+      myPort.sleepMillis(20);
+  }
+}
@@ -0,0 +1,120 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef SERIALPORT_ASYNC_HXX
+#define SERIALPORT_ASYNC_HXX
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "bspf.hxx"
+#include "SerialPort.hxx"
+#include "SpscRing.hxx"
+
+/**
+  A serial port that can move the actual I/O of another (platform) port to
+  threads of its own.  Sending only queues the data in a lock-free ring,
+  from which a writer thread keeps the port busy, and a reader thread
+  collects whatever arrives into a second ring.  So the programmer can
+  encode and queue the next data lines while the previous ones are still
+  on the wire, and pick up answers as soon as they land.
+
+  Without threads, everything is passed straight on to the platform port.
+  Operations that depend on the state of the line (changing the baud
+  rate, resetting the target) wait for all queued data to be sent first.
+
+  @author  Stephen Anthony
+*/
+class SerialPortAsync : public SerialPort
+{
+  public:
+    explicit SerialPortAsync(SerialPort& port);
+    ~SerialPortAsync() override;
+
+    /**
+      Use I/O threads for the port or not; takes effect the next time the
+      port is opened.
+    */
+    void setThreaded(bool threaded) { myThreaded = threaded; }
+
+    bool openPort(const string& device) override;
+    void closePort() override;
+    bool isOpen() override { return myPort.isOpen(); }
+    void setTimeout(uInt32 timeout_milliseconds) override;
+    bool timeoutCheck() override;
+    void sleepMillis(uInt32 milliseconds) override { myPort.sleepMillis(milliseconds); }
+    const StringList& getPortNames() override { return myPort.getPortNames(); }
+    std::optional<PortInfo> portInfo(const string& device) override {
+      return myPort.portInfo(device);
+    }
+    void controlModemLines(bool DTR, bool RTS) override;
+    void controlXonXoff(bool XonXoff) override;
+    bool changeBaud(uInt32 baud) override;
+    uInt32 actualBaud() override { return myPort.actualBaud(); }
+
+  protected:
+    size_t receiveBlock(void* answer, size_t max_size) override;
+    size_t sendBlock(const void* data, size_t size) override;
+    size_t sendBlocks(std::span<const std::string_view> blocks) override;
+    void flushBuffers() override;
+
+  private:
+    void startThreads();
+    void stopThreads();
+
+    // Add data to the transmit ring, waiting for room when it's full
+    void queue(const void* data, size_t size);
+
+    // Wake up the writer, and wait until everything queued has been
+    // handed to the platform port
+    void notifyWriter();
+    void waitForSent();
+
+    void writerLoop();
+    void readerLoop();
+
+  private:
+    SerialPort& myPort;
+    bool myThreaded{false};
+    std::atomic<bool> myRunning{false};
+    std::thread myWriter, myReader;
+
+    static constexpr size_t ourRingSize = 64 * 1024;
+    SpscRing myTxRing{ourRingSize}, myRxRing{ourRingSize};
+    size_t myTxQueued{0};                 // bytes queued so far
+    std::atomic<size_t> myTxWritten{0};   // bytes written so far
+
+    // Only used to sleep and wake up threads; the rings themselves are
+    // lock-free
+    std::mutex myMutex;
+    std::condition_variable myTxReady, myTxDone, myRxReady;
+
+    // Held by the reader while it reads, so buffers can be flushed
+    // without data that was just read turning up afterwards
+    std::mutex myReadMutex;
+
+    std::chrono::steady_clock::time_point myDeadline;
+
+  private:
+    // Following constructors and assignment operators not supported
+    SerialPortAsync() = delete;
+    SerialPortAsync(const SerialPortAsync&) = delete;
+    SerialPortAsync(SerialPortAsync&&) = delete;
+    SerialPortAsync& operator=(const SerialPortAsync&) = delete;
+    SerialPortAsync& operator=(SerialPortAsync&&) = delete;
+};
+
+#endif
@@ -0,0 +1,121 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include "SerialPortCapture.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+SerialPortCapture::SerialPortCapture(SerialPort& port)
+  : SerialPort(),
+    myPort{port}
+{
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortCapture::setCaptureFile(const string& filename)
+{
+  if(filename == "")
+  {
+    myTap.close();
+    return true;
+  }
+  return myTap.open(filename);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortCapture::openPort(const string& device)
+{
+  // Settings are made on this port, but the platform port applies them
+  myPort.setBaud(myBaud);
+  myPort.setControlSwap(myControlLinesSwapped);
+  myPort.setLowLatency(myLowLatency);
+  myPort.setID(myID);
+
+  if(!myPort.openPort(device))
+    return false;
+
+  myTap.record(WireTap::Event::Open, device);
+  myTap.record(WireTap::Event::Baud, std::to_string(myBaud));
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortCapture::closePort()
+{
+  if(myPort.isOpen())
+    myTap.record(WireTap::Event::Close);
+  myPort.closePort();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortCapture::controlModemLines(bool DTR, bool RTS)
+{
+  myPort.controlModemLines(DTR, RTS);
+
+  const char lines[2] = { DTR ? '1' : '0', RTS ? '1' : '0' };
+  myTap.record(WireTap::Event::ModemLines, { lines, 2 });
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortCapture::changeBaud(uInt32 baud)
+{
+  if(!myPort.changeBaud(baud))
+    return false;
+
+  myBaud = baud;
+  myTap.record(WireTap::Event::Baud, std::to_string(baud));
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortCapture::receiveBlock(void* answer, size_t max_size)
+{
+  const size_t size = myPort.receiveBlock(answer, max_size);
+  if(size > 0)
+    myTap.record(WireTap::Event::Receive, { static_cast<const char*>(answer), size });
+
+  return size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortCapture::sendBlock(const void* data, size_t size)
+{
+  const size_t sent = myPort.sendBlock(data, size);
+  if(sent > 0)
+    myTap.record(WireTap::Event::Send, { static_cast<const char*>(data), sent });
+
+  return sent;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortCapture::sendBlocks(std::span<const std::string_view> blocks)
+{
+  const size_t sent = myPort.sendBlocks(blocks);
+  if(sent > 0 && myTap.isOpen())
+  {
+    // Recorded as one write, which is what it was
+    string data;
+    for(auto block: blocks)
+      data += block;
+    data.resize(std::min(sent, data.size()));
+    myTap.record(WireTap::Event::Send, data);
+  }
+  return sent;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortCapture::flushBuffers()
+{
+  myPort.flushBuffers();
+  myTap.record(WireTap::Event::Flush);
+}
@@ -0,0 +1,81 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef SERIALPORT_CAPTURE_HXX
+#define SERIALPORT_CAPTURE_HXX
+
+#include "bspf.hxx"
+#include "SerialPort.hxx"
+#include "WireTap.hxx"
+
+/**
+  A serial port that passes everything on to another (platform) port,
+  recording all data written and read, along with the state changes of
+  the line, in a WireTap capture.  Since the recording is done right at
+  the platform port, the times are those of the actual I/O, even when
+  SerialPortAsync runs it in threads of its own.
+
+  Without a capture file, nothing is recorded.
+
+  @author  Stephen Anthony
+*/
+class SerialPortCapture : public SerialPort
+{
+  public:
+    explicit SerialPortCapture(SerialPort& port);
+    ~SerialPortCapture() override = default;
+
+    /**
+      Record everything from now on in the given file (replacing it), or
+      stop recording for an empty filename.
+
+      @return  False if the file couldn't be created
+    */
+    bool setCaptureFile(const string& filename);
+
+    bool openPort(const string& device) override;
+    void closePort() override;
+    bool isOpen() override { return myPort.isOpen(); }
+    void setTimeout(uInt32 timeout_milliseconds) override { myPort.setTimeout(timeout_milliseconds); }
+    bool timeoutCheck() override { return myPort.timeoutCheck(); }
+    void sleepMillis(uInt32 milliseconds) override { myPort.sleepMillis(milliseconds); }
+    const StringList& getPortNames() override { return myPort.getPortNames(); }
+    std::optional<PortInfo> portInfo(const string& device) override {
+      return myPort.portInfo(device);
+    }
+    void controlModemLines(bool DTR, bool RTS) override;
+    void controlXonXoff(bool XonXoff) override { myPort.controlXonXoff(XonXoff); }
+    bool changeBaud(uInt32 baud) override;
+    uInt32 actualBaud() override { return myPort.actualBaud(); }
+
+  protected:
+    size_t receiveBlock(void* answer, size_t max_size) override;
+    size_t sendBlock(const void* data, size_t size) override;
+    size_t sendBlocks(std::span<const std::string_view> blocks) override;
+    void flushBuffers() override;
+
+  private:
+    SerialPort& myPort;
+    WireTap myTap;
+
+  private:
+    // Following constructors and assignment operators not supported
+    SerialPortCapture() = delete;
+    SerialPortCapture(const SerialPortCapture&) = delete;
+    SerialPortCapture(SerialPortCapture&&) = delete;
+    SerialPortCapture& operator=(const SerialPortCapture&) = delete;
+    SerialPortCapture& operator=(SerialPortCapture&&) = delete;
+};
+
+#endif
@@ -13,6 +13,7 @@
 //=========================================================================
 
 #include <QSerialPortInfo>
+#include <QSettings>
 
 #include "Cart.hxx"
 #include "SerialPortManager.hxx"
@@ -20,7 +21,7 @@
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 SerialPortManager::SerialPortManager()
 {
-  myPort.setBaud(38400);
+  myPort.setBaud(ourISPBaud);
   myPort.setControlSwap(true);
   myPort.closePort();
 }
@@ -32,20 +33,81 @@ void SerialPortManager::setDefaultPort(const string& port)
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-bool SerialPortManager::openCartPort()
+bool SerialPortManager::openCartPort(Cart& cart)
 {
   if(harmonyCartAvailable())
   {
+    QSettings s;
+    s.beginGroup("BaudRates");
+      cart.setPreferredBaud(s.value(baudKey(cart), 0).toUInt());
+    s.endGroup();
+
+    // The port is still open if the bootloader session from detection (or
+    // the last operation) can be picked up again
+    if(myPort.isOpen() && cart.sessionActive(myPort))
+      return true;
+
+    cart.endSession();
+    loadBootTime(myPortName, cart);
     myPort.closePort();
+    myPort.setBaud(myConnectionBaud);
+    myPort.setID(myPortName);
     return myPort.openPort(myPortName);
   }
   return false;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void SerialPortManager::closeCartPort()
+void SerialPortManager::closeCartPort(Cart& cart)
 {
-  myPort.closePort();
+  if(cart.negotiatedBaud() != 0)
+  {
+    QSettings s;
+    s.beginGroup("BaudRates");
+      s.setValue(baudKey(cart), cart.negotiatedBaud());
+    s.endGroup();
+  }
+  saveBootTime(myPortName, cart);
+
+  // Keep the port open while the bootloader is still listening, so the
+  // next operation doesn't need to reset the cart
+  if(!cart.sessionActive(myPort))
+    myPort.closePort();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+QString SerialPortManager::baudKey(const Cart& cart) const
+{
+  return portKey(myPortName) + "-" + QString::number(cart.partID(), 16);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+QString SerialPortManager::portKey(const string& device)
+{
+  // Path separators would otherwise create nested groups
+  QString key = QString::fromStdString(device);
+  return key.replace('/', '_').replace('\\', '_');
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortManager::loadBootTime(const string& device, Cart& cart) const
+{
+  QSettings s;
+  s.beginGroup("BootTimes");
+    cart.setBootTime(s.value(portKey(device), 0).toUInt());
+  s.endGroup();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortManager::saveBootTime(const string& device, const Cart& cart) const
+{
+  if(cart.bootTime() == 0)
+    return;
+
+  QSettings s;
+  s.beginGroup("BootTimes");
+    s.setValue(portKey(device), cart.bootTime());
+  s.endGroup();
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -69,32 +131,52 @@ void SerialPortManager::connectHarmonyCart(Cart& cart)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool SerialPortManager::detect(const string& device, Cart& cart)
 {
+  cart.endSession();
   myPort.closePort();
+  myPort.setBaud(myConnectionBaud);
   myFoundHarmonyCart = false;
 
   if(myPort.openPort(device))
   {
+    loadBootTime(device, cart);
     string version = cart.autodetectHarmony(myPort);
     if(!BSPF::startsWithIgnoreCase(version, "ERROR:"))
     {
       myFoundHarmonyCart = true;
       myPortName = device;
+      saveBootTime(device, cart);
 
-      const auto serialPortInfos = QSerialPortInfo::availablePorts();
-      string cartDescription = "Harmony";
-      for(const auto& portInfo : serialPortInfos)
+      // The port describes itself where the platform allows (which saves
+      // enumerating all ports again), and Qt is asked otherwise
+      string cartDescription;
+      if(const auto info = myPort.portInfo(device))
+        cartDescription = info->description;
+      else
       {
-        if(portInfo.portName().toStdString() == myPortName ||
-           portInfo.systemLocation().toStdString() == myPortName)
+        const auto serialPortInfos = QSerialPortInfo::availablePorts();
+        for(const auto& portInfo : serialPortInfos)
         {
-          cartDescription = portInfo.description().toStdString();
-          break;
+          if(portInfo.portName().toStdString() == myPortName ||
+             portInfo.systemLocation().toStdString() == myPortName)
+          {
+            cartDescription = portInfo.description().toStdString();
+            break;
+          }
         }
       }
+      if(cartDescription == "")
+        cartDescription = "Harmony";
       myVersionID = cartDescription + " [" + version + "] @ '" + myPortName + "'";
+      myPort.setID(myPortName);
     }
   }
-  myPort.closePort();
+
+  // On success, the port stays open for the first operation on the cart
+  if(!myFoundHarmonyCart)
+  {
+    cart.endSession();
+    myPort.closePort();
+  }
   return myFoundHarmonyCart;
 }
 
@@ -15,8 +15,12 @@
 #ifndef SERIALPORT_MANAGER_HXX
 #define SERIALPORT_MANAGER_HXX
 
+#include <QString>
+
 #include "bspf.hxx"
 #include "Cart.hxx"
+#include "SerialPortAsync.hxx"
+#include "SerialPortCapture.hxx"
 
 #if defined(BSPF_WINDOWS)
   #include "SerialPortWINDOWS.hxx"
@@ -37,22 +41,77 @@ class SerialPortManager
     bool harmonyCartAvailable() const;
 
     SerialPort& port();
+
+    /**
+      Do the serial I/O in threads of its own (see SerialPortAsync), from
+      the next time the port is opened.
+    */
+    void setThreadedIO(bool threaded) { myPort.setThreaded(threaded); }
+
+    /**
+      Record all serial I/O from now on in the given file (see WireTap),
+      or stop recording for an empty filename.
+    */
+    bool setCaptureFile(const string& filename) {
+      return myCapturePort.setCaptureFile(filename);
+    }
     const string& portName() const;
     const string& versionID() const;
 
-    bool openCartPort();
-    void closeCartPort();
+    /**
+      Set the rate to connect to the bootloader at (which it picks up
+      during synchronization).  Any rate the serial port can be set to
+      works; the bootloader is then switched to a faster standard rate
+      where allowed (see CartProgrammer::setMaxBaud()).
+    */
+    void setConnectionBaud(uInt32 baud) {
+      myConnectionBaud = baud != 0 ? baud : ourISPBaud;
+    }
+    uInt32 connectionBaud() const { return myConnectionBaud; }
+
+    /**
+      Open the port of a detected cart, at the connection rate.  The
+      fastest rate negotiated with this cart on this port during a
+      previous session is passed on to the cart, to be tried first.  A port still open with an active bootloader session (after
+      detection, or reading flash) is used as is.
+    */
+    bool openCartPort(Cart& cart);
+
+    /**
+      Close the port, remembering the rate negotiated during the last
+      download (if any) for this port and cart.  The port is left open
+      while the bootloader session is still active.
+    */
+    void closeCartPort(Cart& cart);
+
+    // All communication with the bootloader starts out at this rate,
+    // unless another one is set
+    static constexpr uInt32 ourISPBaud = 38400;
 
   private:
     bool detect(const string& device, Cart& cart);
 
+    // Key used to store the negotiated rate for the current port and cart
+    QString baudKey(const Cart& cart) const;
+
+    // Key used to store settings for the given port
+    static QString portKey(const string& device);
+
+    // Remember how long the bootloader on the given port takes to answer
+    // after a reset, across sessions
+    void loadBootTime(const string& device, Cart& cart) const;
+    void saveBootTime(const string& device, const Cart& cart) const;
+
   private:
   #if defined(BSPF_WINDOWS)
-    SerialPortWINDOWS myPort;
+    SerialPortWINDOWS myPlatformPort;
   #elif defined(BSPF_MACOS) || defined(BSPF_UNIX)
-    SerialPortUNIX myPort;
+    SerialPortUNIX myPlatformPort;
   #endif
+    SerialPortCapture myCapturePort{myPlatformPort};
+    SerialPortAsync myPort{myCapturePort};
 
+    uInt32 myConnectionBaud{ourISPBaud};
     bool myFoundHarmonyCart{false};
     string myPortName;
     string myVersionID;
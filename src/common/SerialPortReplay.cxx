@@ -0,0 +1,156 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include "SerialPortReplay.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortReplay::load(const string& filename)
+{
+  const bool loaded = WireTap::load(filename, myRecords);
+
+  mySendPos = myReceivePos = myFlushPos = 0;
+  mySendOffset = myReceiveOffset = 0;
+  seek(mySendPos, WireTap::Event::Send);
+  seek(myReceivePos, WireTap::Event::Receive);
+  myNow = myDeadline = 0;
+  myMismatches = 0;
+
+  return loaded;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortReplay::openPort(const string&)
+{
+  myIsOpen = true;
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortReplay::setTimeout(uInt32 timeout_milliseconds)
+{
+  myDeadline = myNow + timeout_milliseconds * 1000ULL;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+const StringList& SerialPortReplay::getPortNames()
+{
+  myPortNames.clear();
+  myPortNames.emplace_back("replay");
+  return myPortNames;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 SerialPortReplay::capturedBaud() const
+{
+  for(auto r = myRecords.rbegin(); r != myRecords.rend(); ++r)
+    if(r->event == WireTap::Event::Baud)
+      return BSPF::stoi(r->data);
+
+  return 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortReplay::finished() const
+{
+  size_t pos = myReceivePos;
+  seek(pos, WireTap::Event::Receive);
+  return pos >= myRecords.size();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortReplay::receiveBlock(void* answer, size_t max_size)
+{
+  // Nothing more to hand out until the data it answered has been sent;
+  // the wait always times out
+  if(!myIsOpen || myReceivePos >= myRecords.size() || myReceivePos > mySendPos)
+  {
+    myNow = std::max(myNow, myDeadline);
+    return 0;
+  }
+
+  const WireTap::Record& record = myRecords[myReceivePos];
+  const size_t size = std::min(max_size, record.data.size() - myReceiveOffset);
+  memcpy(answer, record.data.data() + myReceiveOffset, size);
+  myNow = std::max(myNow, record.micros);
+
+  myReceiveOffset += size;
+  if(myReceiveOffset == record.data.size())
+  {
+    ++myReceivePos;
+    myReceiveOffset = 0;
+    seek(myReceivePos, WireTap::Event::Receive);
+  }
+  return size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortReplay::sendBlock(const void* data, size_t size)
+{
+  if(!myIsOpen)
+    return 0;
+
+  // The data may be split into writes differently than in the capture
+  const char* buf = static_cast<const char*>(data);
+  bool same = true;
+  for(size_t sent = 0; sent < size; )
+  {
+    if(mySendPos >= myRecords.size())
+    {
+      same = false;
+      break;
+    }
+
+    const string& captured = myRecords[mySendPos].data;
+    const size_t length = std::min(size - sent, captured.size() - mySendOffset);
+    if(memcmp(buf + sent, captured.data() + mySendOffset, length) != 0)
+      same = false;
+
+    sent += length;
+    mySendOffset += length;
+    if(mySendOffset == captured.size())
+    {
+      ++mySendPos;
+      mySendOffset = 0;
+      seek(mySendPos, WireTap::Event::Send);
+    }
+  }
+  if(!same)
+    ++myMismatches;
+
+  return size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortReplay::flushBuffers()
+{
+  // Drop whatever had been received by the time of the matching flush
+  seek(myFlushPos, WireTap::Event::Flush);
+  if(myFlushPos >= myRecords.size())
+    return;
+
+  if(myReceivePos < myFlushPos)
+  {
+    myReceivePos = myFlushPos;
+    myReceiveOffset = 0;
+    seek(myReceivePos, WireTap::Event::Receive);
+  }
+  ++myFlushPos;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortReplay::seek(size_t& pos, WireTap::Event event) const
+{
+  while(pos < myRecords.size() && myRecords[pos].event != event)
+    ++pos;
+}
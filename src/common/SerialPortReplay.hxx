@@ -0,0 +1,111 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef SERIALPORT_REPLAY_HXX
+#define SERIALPORT_REPLAY_HXX
+
+#include "bspf.hxx"
+#include "SerialPort.hxx"
+#include "WireTap.hxx"
+
+/**
+  A serial port that plays back the data received in a WireTap capture,
+  so a session can be run again (with the same image and settings) without
+  the cart, to profile the programmer itself.
+
+  Each chunk of received data is handed out only once everything that
+  was sent before it in the capture has been sent again, and discarding
+  the buffers drops whatever had been received by the matching flush in
+  the capture.  Data that is sent is compared with the capture, and the
+  number of writes that differ is counted; from the first difference on,
+  the session is no longer what was captured.
+
+  Like SerialPortSimulated, the port keeps a virtual clock, set to the
+  capture time of each chunk as it's handed out, so timeouts expire
+  without any waiting.
+
+  @author  Stephen Anthony
+*/
+class SerialPortReplay : public SerialPort
+{
+  public:
+    SerialPortReplay() = default;
+    ~SerialPortReplay() override = default;
+
+    /**
+      Load the capture to play back.
+
+      @return  False if the file isn't a capture, or is damaged
+    */
+    bool load(const string& filename);
+
+    bool openPort(const string& device) override;
+    void closePort() override { myIsOpen = false; }
+    bool isOpen() override { return myIsOpen; }
+    void setTimeout(uInt32 timeout_milliseconds) override;
+    bool timeoutCheck() override { return myNow >= myDeadline; }
+    void sleepMillis(uInt32 milliseconds) override { myNow += milliseconds * 1000ULL; }
+    const StringList& getPortNames() override;
+    void controlModemLines(bool, bool) override { }
+    void controlXonXoff(bool) override { }
+    bool changeBaud(uInt32 baud) override { myBaud = baud; return true; }
+
+    /** Length of the captured session, in microseconds. */
+    uInt64 capturedMicros() const {
+      return myRecords.empty() ? 0 : myRecords.back().micros;
+    }
+
+    /**
+      The last baud rate the port was switched to in the capture, which
+      should be tried first again for the session to go the same way.
+    */
+    uInt32 capturedBaud() const;
+
+    /** Number of writes that differed from the capture. */
+    uInt32 mismatches() const { return myMismatches; }
+
+    /** Answers whether all received data in the capture was handed out. */
+    bool finished() const;
+
+  protected:
+    size_t receiveBlock(void* answer, size_t max_size) override;
+    size_t sendBlock(const void* data, size_t size) override;
+    void flushBuffers() override;
+
+  private:
+    // Move the given position to the next record of the given type, or
+    // past the end
+    void seek(size_t& pos, WireTap::Event event) const;
+
+  private:
+    std::vector<WireTap::Record> myRecords;
+    bool myIsOpen{false};
+
+    // Next data to send and to hand out, as record index and offset
+    size_t mySendPos{0}, mySendOffset{0};
+    size_t myReceivePos{0}, myReceiveOffset{0};
+    size_t myFlushPos{0};
+
+    uInt64 myNow{0}, myDeadline{0};
+    uInt32 myMismatches{0};
+
+  private:
+    // Following constructors and assignment operators not supported
+    SerialPortReplay(const SerialPortReplay&) = delete;
+    SerialPortReplay(SerialPortReplay&&) = delete;
+    SerialPortReplay& operator=(const SerialPortReplay&) = delete;
+    SerialPortReplay& operator=(SerialPortReplay&&) = delete;
+};
+
+#endif
@@ -0,0 +1,179 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include "SerialPortSimulated.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+SerialPortSimulated::SerialPortSimulated(const Config& config)
+  : SerialPort(),
+    myConfig{config},
+    myChip{config.chip},
+    myRandom{config.seed}
+{
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortSimulated::openPort(const string& device)
+{
+  myIsOpen = true;
+  myRxQueue.clear();
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortSimulated::closePort()
+{
+  myIsOpen = false;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortSimulated::setTimeout(uInt32 timeout_milliseconds)
+{
+  myDeadline = myNow + timeout_milliseconds * 1000ULL;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortSimulated::timeoutCheck()
+{
+  return myNow >= myDeadline;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortSimulated::flushBuffers()
+{
+  // Only bytes that have already arrived are discarded
+  while(!myRxQueue.empty() && myRxQueue.front().time <= myNow)
+    myRxQueue.pop_front();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortSimulated::sleepMillis(uInt32 milliseconds)
+{
+  myNow += milliseconds * 1000ULL;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+const StringList& SerialPortSimulated::getPortNames()
+{
+  myPortNames.clear();
+  myPortNames.emplace_back("simulated");
+  return myPortNames;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortSimulated::controlModemLines(bool DTR, bool RTS)
+{
+  // DTR drives RESET and RTS drives the ISP entry pin; any swapping of the
+  // lines is undone by the cart wiring, so it isn't modelled here
+  if(myResetAsserted && !DTR)
+  {
+    myChip.reset();
+    myChipBaud = 0;
+    myRxQueue.clear();
+    myTxFree = myRxFree = myNow;
+    myBootDone = myNow + myConfig.bootMicros;
+  }
+  myResetAsserted = DTR;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortSimulated::receiveBlock(void* answer, size_t max_size)
+{
+  if(!myIsOpen)
+    return 0;
+
+  // Nothing has arrived yet; wait for the next byte or the deadline
+  if(myRxQueue.empty() || myRxQueue.front().time > myNow)
+  {
+    if(!myRxQueue.empty() && myRxQueue.front().time <= myDeadline)
+      myNow = myRxQueue.front().time;
+    else
+    {
+      myNow = std::max(myNow, myDeadline);
+      return 0;
+    }
+  }
+
+  uInt8* buf = static_cast<uInt8*>(answer);
+  size_t size = 0;
+  while(size < max_size && !myRxQueue.empty() && myRxQueue.front().time <= myNow)
+  {
+    buf[size++] = myRxQueue.front().c;
+    myRxQueue.pop_front();
+  }
+  myBytesReceived += size;
+
+  return size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortSimulated::sendBlock(const void* data, size_t size)
+{
+  if(!myIsOpen)
+    return 0;
+
+  const uInt8* buf = static_cast<const uInt8*>(data);
+  const uInt64 hostByte = byteMicros(myBaud);
+  string out;
+
+  for(size_t i = 0; i < size; ++i)
+  {
+    myTxFree = std::max(myNow, myTxFree) + hostByte;
+    const uInt64 arrival = myTxFree + myConfig.latencyMicros;
+
+    // The bootloader locks on to whatever rate the autobaud '?' is sent at;
+    // after that, anything sent at a different rate arrives as garbage
+    if(myConfig.absent || arrival < myBootDone)
+      continue;
+    uInt8 c = corrupt(buf[i]);
+    if(myChipBaud == 0 && c == '?')
+      myChipBaud = myBaud;
+    else if(myChipBaud != 0 && (myChipBaud != myBaud || tooFast()))
+      c = static_cast<uInt8>(myRandom());
+
+    out.clear();
+    const uInt32 busy = myChip.receive(c, out);
+
+    const uInt64 chipByte = byteMicros(myChipBaud ? myChipBaud : myBaud);
+    myRxFree = std::max(arrival + busy, myRxFree);
+    for(auto ch: out)
+    {
+      myRxFree += chipByte;
+      uInt8 r = corrupt(static_cast<uInt8>(ch));
+      if(myChipBaud != myBaud || tooFast())
+        r = static_cast<uInt8>(myRandom());
+      myRxQueue.push_back({ myRxFree + myConfig.latencyMicros, r });
+    }
+
+    // A baud rate change takes effect once its answer has been sent
+    if(myChip.requestedBaud() != 0)
+      myChipBaud = myChip.requestedBaud();
+  }
+  myBytesSent += size;
+
+  return size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt8 SerialPortSimulated::corrupt(uInt8 c)
+{
+  if(myConfig.bitErrorRate > 0.0)
+  {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    for(int bit = 0; bit < 8; ++bit)
+      if(dist(myRandom) < myConfig.bitErrorRate)
+        c ^= (1 << bit);
+  }
+  return c;
+}
@@ -0,0 +1,108 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef SERIALPORT_SIMULATED_HXX
+#define SERIALPORT_SIMULATED_HXX
+
+#include <deque>
+#include <random>
+
+#include "LpcIspEmulator.hxx"
+#include "SerialPort.hxx"
+
+/**
+  A serial port with an emulated Harmony cart on the other end.  No real
+  time passes; instead the port keeps a virtual clock, advanced by the
+  time each byte spends on the wire, by the configured latency, and by
+  the time the bootloader spends in erase and copy operations.  This makes
+  download times and retry behaviour reproducible on any machine.
+
+  @author  Stephen Anthony
+*/
+class SerialPortSimulated : public SerialPort
+{
+  public:
+    struct Config
+    {
+      LpcIspEmulator::Config chip;
+      uInt32 latencyMicros{1000};   // one-way latency of the link
+      double bitErrorRate{0.0};     // probability of a flipped bit, per bit
+      uInt32 seed{1};               // seed for the error generator
+      uInt32 maxBaud{0};            // above this rate the link is unusable (0 = no limit)
+      uInt32 bootMicros{0};         // time from releasing reset until the bootloader listens
+      bool absent{false};           // no cart on the port at all
+    };
+
+  public:
+    explicit SerialPortSimulated(const Config& config);
+    ~SerialPortSimulated() override = default;
+
+    bool openPort(const string& device) override;
+    void closePort() override;
+    bool isOpen() override { return myIsOpen; }
+    void setTimeout(uInt32 timeout_milliseconds) override;
+    bool timeoutCheck() override;
+    void flushBuffers() override;
+    void sleepMillis(uInt32 milliseconds) override;
+    const StringList& getPortNames() override;
+    void controlModemLines(bool DTR, bool RTS) override;
+    void controlXonXoff(bool) override { }
+    bool changeBaud(uInt32 baud) override { myBaud = baud; return true; }
+
+    /** Virtual time elapsed since the port was created, in microseconds. */
+    uInt64 elapsedMicros() const { return myNow; }
+
+    /** Number of bytes that have crossed the link in each direction. */
+    uInt64 bytesSent() const     { return myBytesSent;     }
+    uInt64 bytesReceived() const { return myBytesReceived; }
+
+    /** The emulated bootloader. */
+    LpcIspEmulator& chip() { return myChip; }
+
+  protected:
+    size_t receiveBlock(void* answer, size_t max_size) override;
+    size_t sendBlock(const void* data, size_t size) override;
+
+  private:
+    uInt64 byteMicros(uInt32 baud) const { return (10'000'000ULL + baud - 1) / baud; }
+    uInt8 corrupt(uInt8 c);
+    bool tooFast() const { return myConfig.maxBaud != 0 && myBaud > myConfig.maxBaud; }
+
+  private:
+    struct RxByte { uInt64 time; uInt8 c; };
+
+    Config myConfig;
+    LpcIspEmulator myChip;
+    bool myIsOpen{false};
+    bool myResetAsserted{false};
+
+    uInt64 myNow{0}, myDeadline{0}, myBootDone{0};
+    uInt64 myTxFree{0}, myRxFree{0};
+    uInt32 myChipBaud{0};   // baud rate the bootloader locked on to; 0 in autobaud
+
+    std::deque<RxByte> myRxQueue;
+    uInt64 myBytesSent{0}, myBytesReceived{0};
+
+    std::mt19937 myRandom;
+
+  private:
+    // Following constructors and assignment operators not supported
+    SerialPortSimulated() = delete;
+    SerialPortSimulated(const SerialPortSimulated&) = delete;
+    SerialPortSimulated(SerialPortSimulated&&) = delete;
+    SerialPortSimulated& operator=(const SerialPortSimulated&) = delete;
+    SerialPortSimulated& operator=(SerialPortSimulated&&) = delete;
+};
+
+#endif
@@ -0,0 +1,116 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef SPSC_RING_HXX
+#define SPSC_RING_HXX
+
+#include <atomic>
+
+#include "bspf.hxx"
+
+/**
+  A lock-free ring buffer of bytes, for passing data from exactly one
+  producer thread to exactly one consumer thread.  Each side only writes
+  its own index, and publishes it (with release ordering) after copying
+  the data, so neither side ever waits for the other; when the ring is
+  full or empty, push and pop just move fewer bytes.
+
+  @author  Stephen Anthony
+*/
+class SpscRing
+{
+  public:
+    /**
+      Create a ring holding up to 'capacity' bytes (a power of two).
+    */
+    explicit SpscRing(size_t capacity)
+      : myBuffer{std::make_unique<char[]>(capacity)},
+        myCapacity{capacity}
+    {
+    }
+    ~SpscRing() = default;
+
+    /**
+      Add as much of the given data as fits (producer only).
+
+      @return  The number of bytes added
+    */
+    size_t push(const void* data, size_t size) {
+      const size_t tail = myTail.load(std::memory_order_relaxed);
+      const size_t head = myHead.load(std::memory_order_acquire);
+      size = std::min(size, myCapacity - (tail - head));
+      write(tail, static_cast<const char*>(data), size);
+      myTail.store(tail + size, std::memory_order_release);
+      return size;
+    }
+
+    /**
+      Remove up to 'size' bytes into the given buffer (consumer only).
+
+      @return  The number of bytes removed
+    */
+    size_t pop(void* data, size_t size) {
+      const size_t head = myHead.load(std::memory_order_relaxed);
+      const size_t tail = myTail.load(std::memory_order_acquire);
+      size = std::min(size, tail - head);
+      read(head, static_cast<char*>(data), size);
+      myHead.store(head + size, std::memory_order_release);
+      return size;
+    }
+
+    /** Discard everything in the ring (consumer only). */
+    void clear() {
+      myHead.store(myTail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /** The number of bytes in the ring; exact only for the consumer. */
+    size_t size() const {
+      return myTail.load(std::memory_order_acquire) - myHead.load(std::memory_order_acquire);
+    }
+
+  private:
+    // Copy to/from the ring at the given index, in two parts when the
+    // range wraps around the end of the ring
+    void write(size_t index, const char* data, size_t size) {
+      const size_t offset = index & (myCapacity - 1);
+      const size_t first = std::min(size, myCapacity - offset);
+      std::memcpy(myBuffer.get() + offset, data, first);
+      std::memcpy(myBuffer.get(), data + first, size - first);
+    }
+    void read(size_t index, char* data, size_t size) const {
+      const size_t offset = index & (myCapacity - 1);
+      const size_t first = std::min(size, myCapacity - offset);
+      std::memcpy(data, myBuffer.get() + offset, first);
+      std::memcpy(data + first, myBuffer.get(), size - first);
+    }
+
+  private:
+    std::unique_ptr<char[]> myBuffer;
+    const size_t myCapacity;
+
+    // Indices only ever increase; kept on separate cache lines, since each
+    // is written by a different thread
+    alignas(64) std::atomic<size_t> myHead{0};   // written by the consumer
+    alignas(64) std::atomic<size_t> myTail{0};   // written by the producer
+
+  private:
+    // Following constructors and assignment operators not supported
+    SpscRing() = delete;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing(SpscRing&&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+    SpscRing& operator=(SpscRing&&) = delete;
+};
+
+#endif
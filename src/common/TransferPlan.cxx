@@ -0,0 +1,111 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include "TransferPlan.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool TransferPlan::prepare(const uInt8* image, uInt32 size, uInt32 partID)
+{
+  myCommands.clear();
+  for(auto& [key, t]: myTransfers)
+    t.windowEnds.clear();
+
+  if(partID != myPartID || size != myImage.size())
+  {
+    myImage.assign(image, image + size);
+    myPartID = partID;
+    myTransfers.clear();
+
+    return false;
+  }
+
+  // Only the parts of the image that changed need to be encoded again
+  for(auto it = myTransfers.begin(); it != myTransfers.end(); )
+  {
+    const uInt32 first = std::min(it->second.start, size);
+    const uInt32 last  = std::min(it->second.start + it->second.length, size);
+    if(std::equal(myImage.begin() + first, myImage.begin() + last, image + first))
+      ++it;
+    else
+      it = myTransfers.erase(it);
+  }
+  std::copy_n(image, size, myImage.begin());
+
+  return !myTransfers.empty();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+const TransferPlan::Transfer& TransferPlan::transfer(uInt32 start, uInt32 length)
+{
+  Transfer& t = myTransfers[{ start, length }];
+  if(t.lines.empty() && length > 0)
+  {
+    t.start = start;
+    t.length = length;
+
+    constexpr uInt32 BLOCK = Uuencode::LINE_BYTES * 4;
+    uInt8 block[BLOCK];
+    for(uInt32 pos = start; pos < start + length; pos += BLOCK)
+    {
+      const uInt32 count = pos < myImage.size() ?
+          std::min<uInt32>(BLOCK, static_cast<uInt32>(myImage.size()) - pos) : 0;
+      std::copy_n(myImage.begin() + pos, count, block);
+      std::fill(block + count, block + BLOCK, 0);
+
+      for(uInt32 i = 0; i < 4; ++i)
+      {
+        Line& line = t.lines.emplace_back();
+        t.sums.push_back(Uuencode::encodeLine(block + i * Uuencode::LINE_BYTES, line.data()));
+      }
+    }
+  }
+  return t;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferPlan::addWindowEnd(uInt32 start, uInt32 length, uInt32 line)
+{
+  if(auto it = myTransfers.find({ start, length }); it != myTransfers.end())
+    it->second.windowEnds.insert(line);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TransferPlan::dump(ostream& out) const
+{
+  out << "Transfer plan for part ID 0x" << std::hex << myPartID << std::dec
+      << ", image of " << myImage.size() << " bytes\n";
+
+  for(const auto& [key, t]: myTransfers)
+  {
+    out << "\nBytes " << t.start << "-" << (t.start + t.length - 1) << " ("
+        << t.lines.size() << " lines" << (t.windowEnds.empty() ?
+           ", not sent during the last download)\n" : ")\n");
+
+    uInt32 checksum = 0;
+    for(uInt32 i = 0; i < t.lines.size(); ++i)
+    {
+      out << "  " << string_view(t.line(i), Uuencode::LINE_SIZE - 3) << '\n';
+      checksum += t.sum(i);
+      if(t.windowEnds.count(i))
+      {
+        out << "  checksum " << checksum << '\n';
+        checksum = 0;
+      }
+    }
+  }
+
+  out << "\nCommands issued during the last download:\n";
+  for(const auto& command: myCommands)
+    out << "  " << command.substr(0, command.find_first_of("\r\n")) << '\n';
+}
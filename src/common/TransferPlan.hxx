@@ -0,0 +1,113 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef TRANSFER_PLAN_HXX
+#define TRANSFER_PLAN_HXX
+
+#include <map>
+#include <set>
+
+#include "bspf.hxx"
+#include "Uuencode.hxx"
+
+/**
+  The encoded form of an image, as sent to the bootloader with 'W'
+  commands.  Each part of the image that is written to RAM is uuencoded
+  only once, on first use, along with the checksum of every line; from
+  then on, retries and downloads of the same image to further carts just
+  replay the encoded lines.
+
+  Which commands a download issues depends on the current contents of the
+  cart (see CartProgrammer::setDifferential() and friends), so rather than
+  being fixed up front, the commands are recorded as they're issued.  The
+  whole plan can be written out for inspection with dump().
+
+  @author  Stephen Anthony
+*/
+class TransferPlan
+{
+  public:
+    using Line = std::array<char, Uuencode::LINE_SIZE>;
+
+    // The encoded lines for one 'W' command
+    struct Transfer
+    {
+      uInt32 start{0}, length{0};
+      std::vector<Line> lines;
+      uIntArray sums;
+      std::set<uInt32> windowEnds;  // lines followed by a checksum last time
+
+      const char* line(uInt32 i) const { return lines[i].data(); }
+      std::string_view text(uInt32 i) const {
+        return { lines[i].data(), Uuencode::LINE_SIZE - 1 };
+      }
+      uInt32 sum(uInt32 i) const { return sums[i]; }
+    };
+
+  public:
+    TransferPlan() = default;
+    ~TransferPlan() = default;
+
+    /**
+      Get ready to download the given image to the given part.  For the
+      same part and image size as last time, everything encoded so far is
+      kept, except where the image has changed; otherwise the plan starts
+      over.  The recorded commands are always cleared.
+
+      @return  True if any of the existing plan was kept
+    */
+    bool prepare(const uInt8* image, uInt32 size, uInt32 partID);
+
+    /**
+      The encoded lines for writing the given part of the image to RAM,
+      encoded now if this is their first use.  The part is sent in whole
+      blocks of 4 lines (180 bytes), padded with zeros past the end of
+      the image.
+    */
+    const Transfer& transfer(uInt32 start, uInt32 length);
+
+    /** Record a command issued during the download. */
+    void addCommand(const string& command) { myCommands.push_back(command); }
+
+    /**
+      Record that the checksum of a window was sent after the given line
+      of the given part of the image.  The window size changes with the
+      error rate of the link, so where the checksums go is only known as
+      they're sent.
+    */
+    void addWindowEnd(uInt32 start, uInt32 length, uInt32 line);
+
+    /**
+      Write the plan in readable form: every encoded line, the checksum
+      after every window as sent during the last download, and the
+      commands recorded during it.
+    */
+    void dump(ostream& out) const;
+
+  private:
+    ByteArray myImage;
+    uInt32 myPartID{0};
+
+    std::map<std::pair<uInt32, uInt32>, Transfer> myTransfers;
+    StringList myCommands;
+
+  private:
+    // Following constructors and assignment operators not supported
+    TransferPlan(const TransferPlan&) = delete;
+    TransferPlan(TransferPlan&&) = delete;
+    TransferPlan& operator=(const TransferPlan&) = delete;
+    TransferPlan& operator=(TransferPlan&&) = delete;
+};
+
+#endif
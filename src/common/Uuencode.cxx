@@ -0,0 +1,73 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include "Uuencode.hxx"
+
+namespace {
+  // Each 12-bit value maps to the two characters encoding it, stored in
+  // output order; 0 is sent as '`' rather than ' ', as the bootloader does
+  constexpr std::array<std::array<char, 2>, 4096> ourEncodeTable = [] {
+    std::array<std::array<char, 2>, 4096> table{};
+    auto encode = [](uInt32 c) { return static_cast<char>(c == 0 ? 0x60 : c + 0x20); };
+    for(uInt32 i = 0; i < table.size(); ++i)
+      table[i] = { encode(i >> 6), encode(i & 0x3f) };
+    return table;
+  }();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 Uuencode::encodeLine(const uInt8* data, char* line)
+{
+  uInt32 sum = 0;
+  for(uInt32 i = 0; i < LINE_BYTES; ++i)
+    sum += data[i];
+
+  *line++ = ' ' + LINE_BYTES;
+  for(uInt32 i = 0; i < LINE_BYTES; i += 3, line += 4)
+  {
+    const uInt32 k = (data[i] << 16) | (data[i+1] << 8) | data[i+2];
+    std::memcpy(line,     ourEncodeTable[k >> 12].data(),   2);
+    std::memcpy(line + 2, ourEncodeTable[k & 0xfff].data(), 2);
+  }
+  line[0] = '\r';
+  line[1] = '\n';
+  line[2] = 0;
+
+  return sum;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 Uuencode::decodeLine(const char* line, uInt8* data, uInt32& sum)
+{
+  auto decode = [](char c) { return static_cast<uInt32>(c - 0x20) & 0x3f; };
+
+  const uInt32 length = decode(line[0]);
+  if(length > LINE_BYTES || std::strlen(line) < 1 + (length + 2) / 3 * 4)
+    return 0;
+
+  for(uInt32 i = 0; i < length; i += 3)
+  {
+    const char* in = line + 1 + i / 3 * 4;
+    const uInt32 k = (decode(in[0]) << 18) | (decode(in[1]) << 12) |
+                     (decode(in[2]) << 6)  |  decode(in[3]);
+
+    for(uInt32 j = 0; j < 3 && i + j < length; ++j)
+    {
+      data[i + j] = static_cast<uInt8>(k >> (16 - 8 * j));
+      sum += data[i + j];
+    }
+  }
+
+  return length;
+}
@@ -0,0 +1,70 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef UUENCODE_HXX
+#define UUENCODE_HXX
+
+#include "bspf.hxx"
+
+/**
+  Encoding and decoding of the uuencoded data lines used by the LPC ISP
+  bootloader for the 'W' and 'R' commands.  A full line carries 45 bytes
+  as 60 characters, preceded by a length character and followed by
+  <CR><LF>; the bootloader checksum is the plain sum of the bytes.
+
+  Encoding is table-driven: each 12-bit half of a 3-byte group maps
+  directly to its two output characters, so a line takes 30 lookups and
+  no per-character shifting or branching.
+
+  @author  Stephen Anthony
+*/
+class Uuencode
+{
+  public:
+    /** Number of data bytes in a full line. */
+    static constexpr uInt32 LINE_BYTES = 45;
+
+    /** Buffer size needed for an encoded line, including <CR><LF> and 0. */
+    static constexpr uInt32 LINE_SIZE = 1 + LINE_BYTES / 3 * 4 + 3;
+
+    /**
+      Encode one full line of 45 bytes.
+
+      @param data  The 45 bytes to encode
+      @param line  Receives the encoded line (LINE_SIZE characters),
+                   terminated with <CR><LF> and a 0 byte
+      @return  The sum of the 45 bytes, for the block checksum
+    */
+    static uInt32 encodeLine(const uInt8* data, char* line);
+
+    /**
+      Decode one line, as received from the bootloader.
+
+      @param line  The line to decode; anything after the data is ignored
+      @param data  Receives the decoded bytes (up to 45)
+      @param sum   The sum of the decoded bytes is added to this
+      @return  The number of bytes decoded, or 0 if the line is malformed
+    */
+    static uInt32 decodeLine(const char* line, uInt8* data, uInt32& sum);
+
+  private:
+    // Following constructors and assignment operators not supported
+    Uuencode() = delete;
+    Uuencode(const Uuencode&) = delete;
+    Uuencode(Uuencode&&) = delete;
+    Uuencode& operator=(const Uuencode&) = delete;
+    Uuencode& operator=(Uuencode&&) = delete;
+};
+
+#endif
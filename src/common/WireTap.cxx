@@ -0,0 +1,146 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include "WireTap.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool WireTap::open(const string& filename)
+{
+  close();
+
+  std::lock_guard<std::mutex> lock(myMutex);
+  myOut.open(filename, std::ios::binary | std::ios::trunc);
+  if(!myOut.is_open())
+    return false;
+
+  myOut.write(ourMagic, 4);
+  myOut.put(static_cast<char>(ourVersion));
+  myStart = std::chrono::steady_clock::now();
+  myLastMicros = 0;
+
+  return myOut.good();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void WireTap::close()
+{
+  std::lock_guard<std::mutex> lock(myMutex);
+  if(myOut.is_open())
+    myOut.close();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void WireTap::record(Event event, std::string_view data)
+{
+  // The time is taken before the lock, so it's as close to the actual
+  // event as possible; records are still written in order of their times
+  const auto now = std::chrono::steady_clock::now();
+
+  std::lock_guard<std::mutex> lock(myMutex);
+  if(!myOut.is_open())
+    return;
+
+  const uInt64 micros = std::max<uInt64>(myLastMicros,
+      std::chrono::duration_cast<std::chrono::microseconds>(now - myStart).count());
+
+  myOut.put(static_cast<char>(event));
+  writeVarint(myOut, micros - myLastMicros);
+  writeVarint(myOut, data.size());
+  myOut.write(data.data(), data.size());
+  myLastMicros = micros;
+
+  // Make sure the capture survives whatever happens next
+  if(event == Event::Close)
+    myOut.flush();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool WireTap::load(const string& filename, std::vector<Record>& records)
+{
+  records.clear();
+
+  std::ifstream in(filename, std::ios::binary);
+  char magic[5] = { 0 };
+  if(!in.read(magic, 5) || memcmp(magic, ourMagic, 4) != 0 ||
+     static_cast<uInt8>(magic[4]) != ourVersion)
+    return false;
+
+  uInt64 micros = 0;
+  int type = 0;
+  while((type = in.get()) != EOF)
+  {
+    uInt64 delta = 0, size = 0;
+    if(type > static_cast<int>(Event::ModemLines) ||
+       !readVarint(in, delta) || !readVarint(in, size) || size > ourMaxRecord)
+      return false;
+
+    Record record;
+    micros += delta;
+    record.micros = micros;
+    record.event = static_cast<Event>(type);
+    record.data.resize(size);
+    if(!in.read(record.data.data(), size))
+      return false;
+
+    records.push_back(std::move(record));
+  }
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+const char* WireTap::eventName(Event event)
+{
+  switch(event)
+  {
+    case Event::Open:        return "open";
+    case Event::Close:       return "close";
+    case Event::Send:        return "send";
+    case Event::Receive:     return "receive";
+    case Event::Flush:       return "flush";
+    case Event::Baud:        return "baud";
+    case Event::ModemLines:  return "lines";
+  }
+  return "";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void WireTap::writeVarint(ostream& out, uInt64 value)
+{
+  do
+  {
+    uInt8 c = value & 0x7F;
+    value >>= 7;
+    if(value != 0)
+      c |= 0x80;
+    out.put(static_cast<char>(c));
+  }
+  while(value != 0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool WireTap::readVarint(istream& in, uInt64& value)
+{
+  value = 0;
+  for(int shift = 0; shift < 64; shift += 7)
+  {
+    const int c = in.get();
+    if(c == EOF)
+      return false;
+
+    value |= static_cast<uInt64>(c & 0x7F) << shift;
+    if(!(c & 0x80))
+      return true;
+  }
+  return false;
+}
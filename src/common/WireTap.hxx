@@ -0,0 +1,116 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef WIRE_TAP_HXX
+#define WIRE_TAP_HXX
+
+#include <chrono>
+#include <mutex>
+
+#include "bspf.hxx"
+
+/**
+  A capture of everything that passed through a serial port, with the
+  time (in microseconds since the capture started) of each event.  Data
+  is recorded in the chunks it was written and read in, so the gaps
+  between commands and the time the target took to answer them can be
+  measured afterwards.
+
+  The file starts with the 4 bytes "HCWT" and a version byte, followed by
+  one record per event: the event type (1 byte), the time since the
+  previous record and the size of the data (both as LEB128 varints), and
+  the data itself.  Baud rates are stored as decimal text, and the state
+  of the modem lines as '0' or '1' for DTR and then RTS.
+
+  Recording may be done from several threads at once.
+
+  @author  Stephen Anthony
+*/
+class WireTap
+{
+  public:
+    enum class Event : uInt8 {
+      Open,         // port opened; data is the device name
+      Close,        // port closed
+      Send,         // data written to the port
+      Receive,      // data read from the port
+      Flush,        // buffers discarded
+      Baud,         // baud rate changed
+      ModemLines    // DTR/RTS changed
+    };
+
+    struct Record
+    {
+      uInt64 micros{0};
+      Event event{Event::Open};
+      string data;
+    };
+
+  public:
+    WireTap() = default;
+    ~WireTap() { close(); }
+
+    /**
+      Start a new capture in the given file, replacing any existing one.
+
+      @return  False if the file couldn't be created
+    */
+    bool open(const string& filename);
+
+    /** Finish the current capture, if any. */
+    void close();
+
+    /** Answers whether a capture is in progress. */
+    bool isOpen() const { return myOut.is_open(); }
+
+    /** Record an event, with the current time, if a capture is in progress. */
+    void record(Event event, std::string_view data = {});
+
+    /**
+      Read a whole capture, converting the times to be relative to its
+      start.
+
+      @return  False if the file isn't a capture, or is damaged; the
+               records up to the damage are still returned
+    */
+    static bool load(const string& filename, std::vector<Record>& records);
+
+    /** Short name of the given event, for display. */
+    static const char* eventName(Event event);
+
+  private:
+    static void writeVarint(ostream& out, uInt64 value);
+    static bool readVarint(istream& in, uInt64& value);
+
+  private:
+    std::ofstream myOut;
+    std::mutex myMutex;
+    std::chrono::steady_clock::time_point myStart;
+    uInt64 myLastMicros{0};
+
+    static constexpr char ourMagic[] = "HCWT";
+    static constexpr uInt8 ourVersion = 1;
+
+    // No single read or write comes anywhere near this
+    static constexpr uInt64 ourMaxRecord = 1024 * 1024;
+
+  private:
+    // Following constructors and assignment operators not supported
+    WireTap(const WireTap&) = delete;
+    WireTap(WireTap&&) = delete;
+    WireTap& operator=(const WireTap&) = delete;
+    WireTap& operator=(WireTap&&) = delete;
+};
+
+#endif
@@ -12,6 +12,8 @@
 // of this file, and for a DISCLAIMER OF ALL WARRANTIES.
 //=========================================================================
 
+#include <chrono>
+
 #include <QApplication>
 #include <QFile>
 
@@ -19,6 +21,8 @@
 #include "Bankswitch.hxx"
 #include "Cart.hxx"
 #include "SerialPortManager.hxx"
+#include "SerialPortReplay.hxx"
+#include "SerialPortSimulated.hxx"
 #include "HarmonyCartWindow.hxx"
 #include "Version.hxx"
 
@@ -36,6 +40,31 @@ void usage()
        << "              Otherwise, the datafile is treated as a ROM image instead\n"
        << "  -bs=[type]  Specify the bankswitching scheme for a ROM image\n"
        << "              (default is 'auto')\n"
+       << "  -read=file  Read the contents of the cart's flash into the given file,\n"
+       << "              instead of downloading a datafile\n"
+       << "  -plan=file  After downloading, write the encoded data and the commands\n"
+       << "              sent to the cart into the given file\n"
+       << "  -baud=n     Connect to the cart at the given baud rate (default is\n"
+       << "              38400); under Linux, any rate the serial port can run\n"
+       << "              at may be used\n"
+       << "  -port=name  Look for the cart on the given serial port first, before\n"
+       << "              searching all of them (e.g. a fakecart pseudo-terminal)\n"
+       << "  -capture=file\n"
+       << "              Record all serial I/O, with the time of each read and write,\n"
+       << "              into the given file (see the 'wiretap' tool); the flash\n"
+       << "              cache isn't used, so the session can be replayed\n"
+       << "  -replay=file\n"
+       << "              Play back a capture instead of talking to a cart; use the same\n"
+       << "              datafile and options as when it was recorded\n"
+       << "  -simulate[=part]\n"
+       << "              Talk to an emulated cart with the given LPC part (default\n"
+       << "              is '2103') instead of a real one, and report the time the\n"
+       << "              operation would have taken on the simulated link\n"
+       << "  -simber=n   Probability of each bit being flipped on the simulated link\n"
+       << "              (default is 0)\n"
+       << "  -simlatency=n\n"
+       << "              One-way latency of the simulated link, in microseconds\n"
+       << "              (default is 1000)\n"
        << "  -help       Displays the message you're now reading\n"
        << '\n'
        << "This software is Copyright (c) 2009-2026 Stephen Anthony, and is released\n"
@@ -48,6 +77,15 @@ void runCommandlineApp(HarmonyCartWindow& win, int ac, char* av[])
   string datafile = "";
   Bankswitch::Type bstype = Bankswitch::Type::_AUTO;
   bool biosupdate = false;
+  string readfile = "";
+  string planfile = "";
+  string portname = "";
+  uInt32 baud = 0;
+  string capturefile = "";
+  string replayfile = "";
+  string simpart = "";
+  double simber = 0.0;
+  uInt32 simlatency = 1000;
 
   // Parse commandline args
   for(int i = 1; i < ac; ++i)
@@ -56,6 +94,26 @@ void runCommandlineApp(HarmonyCartWindow& win, int ac, char* av[])
       bstype = Bankswitch::nameToType(av[i]+4);
     else if(BSPF::equalsIgnoreCase(av[i], "-bios"))
       biosupdate = true;
+    else if(BSPF::startsWithIgnoreCase(av[i], "-read="))
+      readfile = av[i]+6;
+    else if(BSPF::startsWithIgnoreCase(av[i], "-plan="))
+      planfile = av[i]+6;
+    else if(BSPF::startsWithIgnoreCase(av[i], "-port="))
+      portname = av[i]+6;
+    else if(BSPF::startsWithIgnoreCase(av[i], "-baud="))
+      baud = static_cast<uInt32>(atoi(av[i]+6));
+    else if(BSPF::startsWithIgnoreCase(av[i], "-capture="))
+      capturefile = av[i]+9;
+    else if(BSPF::startsWithIgnoreCase(av[i], "-replay="))
+      replayfile = av[i]+8;
+    else if(BSPF::equalsIgnoreCase(av[i], "-simulate"))
+      simpart = "2103";
+    else if(BSPF::startsWithIgnoreCase(av[i], "-simulate="))
+      simpart = av[i]+10;
+    else if(BSPF::startsWithIgnoreCase(av[i], "-simber="))
+      simber = atof(av[i]+8);
+    else if(BSPF::startsWithIgnoreCase(av[i], "-simlatency="))
+      simlatency = static_cast<uInt32>(atoi(av[i]+12));
     else if(BSPF::equalsIgnoreCase(av[i], "-help"))
     {
       usage();
@@ -76,20 +134,111 @@ void runCommandlineApp(HarmonyCartWindow& win, int ac, char* av[])
   Cart& cart = win.cart();
   cart.setLogger(&cout);
   SerialPortManager& manager = win.portManager();
+  if(baud != 0)
+    manager.setConnectionBaud(baud);
+
+  // An emulated cart, or a capture being played back, is used through a
+  // port of its own, which is always open; no real time passes on it
+  unique_ptr<SerialPortSimulated> simport;
+  unique_ptr<SerialPortReplay> replayport;
+  SerialPort* offline = nullptr;
+  const auto start = std::chrono::steady_clock::now();
+
+  if(simpart != "")
+  {
+    SerialPortSimulated::Config config;
+    if(!config.chip.setPart(simpart))
+    {
+      cout << "Unknown LPC part \'" << simpart << "\'\n";
+      return;
+    }
+    config.bitErrorRate = simber;
+    config.latencyMicros = simlatency;
 
-  manager.connectHarmonyCart(cart);
-  if(manager.harmonyCartAvailable())
+    simport = make_unique<SerialPortSimulated>(config);
+    offline = simport.get();
+  }
+  else if(replayfile != "")
   {
-    cout << manager.versionID() << "\n";
+    replayport = make_unique<SerialPortReplay>();
+    if(!replayport->load(replayfile))
+    {
+      cout << "Couldn't load capture \'" << replayfile << "\'\n";
+      return;
+    }
+    // Try the rate the captured session ended up using first, as it did
+    cart.setPreferredBaud(replayport->capturedBaud());
+    offline = replayport.get();
+  }
+
+  if(offline)
+  {
+    // The cache in the settings belongs to real carts, and would make the
+    // outcome depend on earlier runs
+    cart.detachFlashCache();
+
+    offline->setBaud(manager.connectionBaud());
+    offline->setControlSwap(true);
+    offline->openPort(offline->getPortNames().front());
+
+    const string version = cart.autodetectHarmony(*offline);
+    if(BSPF::startsWithIgnoreCase(version, "ERROR:"))
+    {
+      cout << "Harmony Cart not detected\n";
+      return;
+    }
+    cout << "Harmony [" << version << "] @ \'" << offline->getPortNames().front() << "\'\n";
   }
   else
   {
-    cout << "Harmony Cart not detected\n";
-    return;
+    if(capturefile != "")
+    {
+      if(!manager.setCaptureFile(capturefile))
+      {
+        cout << "Couldn't create capture file \'" << capturefile << "\'\n";
+        return;
+      }
+      // What the cache holds isn't part of the capture, so a replay
+      // couldn't reproduce the commands it leads to
+      cart.detachFlashCache();
+    }
+    if(portname != "")
+      manager.setDefaultPort(portname);
+    manager.connectHarmonyCart(cart);
+    if(manager.harmonyCartAvailable())
+    {
+      cout << manager.versionID() << "\n";
+    }
+    else
+    {
+      cout << "Harmony Cart not detected\n";
+      return;
+    }
   }
 
-  // Are we updating the BIOS or a single-load ROM?
-  if(biosupdate)
+  SerialPort& port = offline ? *offline : manager.port();
+  const auto openPort = [&]() {
+    return offline || manager.openCartPort(cart);
+  };
+  const auto closePort = [&]() {
+    if(!offline)
+      manager.closeCartPort(cart);
+  };
+
+  // Are we reading flash, updating the BIOS or a single-load ROM?
+  if(readfile != "")
+  {
+    cout << "Reading flash contents into \'" << readfile << "\'...\n";
+    if(openPort())
+    {
+      // Read the flash, but don't show a graphical progress indicator
+      cout << cart.readFlash(port, readfile, false) << "\n";
+      closePort();
+    }
+    else
+      cout << "Couldn't open Harmony Cart\n";
+  }
+  else if(biosupdate)
   {
     cout << "Downloading BIOS file...\n";
     if(datafile == "" || !QFile::exists(QString(datafile.c_str())))
@@ -98,12 +247,14 @@ void runCommandlineApp(HarmonyCartWindow& win, int ac, char* av[])
       return;
     }
 
-    if(manager.openCartPort())
+    if(openPort())
     {
       // Download the BIOS, but don't show a graphical progress indicator
-      cart.downloadBIOS(manager.port(), datafile, win.verifyDownload(),
+      cart.downloadBIOS(port, datafile, win.verifyDownload(),
                         false, win.continueOnErrors());
-      manager.closeCartPort();
+      closePort();
+      if(planfile != "")
+        cout << cart.writeTransferPlan(planfile) << "\n";
     }
     else
       cout << "Couldn't open Harmony Cart\n";
@@ -117,17 +268,36 @@ void runCommandlineApp(HarmonyCartWindow& win, int ac, char* av[])
       return;
     }
 
-    if(manager.openCartPort())
+    if(openPort())
     {
       // Download the ROM, but don't show a graphical progress indicator
-      cart.downloadROM(manager.port(), win.armPath(), datafile,
+      cart.downloadROM(port, win.armPath(), datafile,
                        bstype, win.verifyDownload(),
                        false, win.continueOnErrors());
-      manager.closeCartPort();
+      closePort();
+      if(planfile != "")
+        cout << cart.writeTransferPlan(planfile) << "\n";
     }
     else
       cout << "Couldn't open Harmony Cart\n";
   }
+
+  if(simport)
+    cout << "Simulated time: " << std::fixed << std::setprecision(3)
+         << simport->elapsedMicros() / 1000000.0 << " seconds ("
+         << simport->bytesSent() << " bytes sent, "
+         << simport->bytesReceived() << " received)\n";
+  else if(replayport)
+  {
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    cout << "Replay took " << std::fixed << std::setprecision(3) << elapsed.count()
+         << " seconds, for a captured session of "
+         << replayport->capturedMicros() / 1000000.0 << " seconds\n";
+    if(replayport->mismatches() != 0)
+      cout << replayport->mismatches() << " writes differed from the capture\n";
+    if(!replayport->finished())
+      cout << "Not all of the captured data was used\n";
+  }
 }
 
 
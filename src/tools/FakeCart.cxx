@@ -0,0 +1,390 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <deque>
+#include <random>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "bspf.hxx"
+#include "LpcIspEmulator.hxx"
+#include "Termios2.hxx"
+
+/**
+  A stand-in for a Harmony cart, on a pseudo-terminal.  The slave side
+  of the pty is used by harmonycart like any other serial port (with
+  '-port=<device>'), so the whole program can be run and timed without
+  any hardware, including the real serial port code.
+
+  A pty has no modem lines, so a reset can't be seen directly.  Instead
+  the pty runs in packet mode, where the host discarding its buffers is
+  reported; a reset is recognised as such a flush followed by the '?'
+  that starts autobaud, which is exactly what CartProgrammer::reset()
+  and the synchronization after it do.
+
+  By default, bytes are paced at the baud rate the host has set on the
+  port, so download times are close to those over a real serial link.
+
+  @author  Stephen Anthony
+*/
+class FakeCart
+{
+  public:
+    struct Config
+    {
+      LpcIspEmulator::Config chip;
+      uInt32 latencyMicros{0};    // additional one-way latency of the link
+      double bitErrorRate{0.0};   // probability of a flipped bit, per bit
+      uInt32 seed{1};             // seed for the error generator
+      bool paced{true};           // bytes take as long as on a real link
+      bool verbose{false};        // report resets and baud rate changes
+    };
+
+  public:
+    explicit FakeCart(const Config& config);
+    ~FakeCart();
+
+    /**
+      Create the pseudo-terminal.
+
+      @return  Name of the slave device, or an empty string on failure
+    */
+    string open();
+
+    /** Answer the host until interrupted. */
+    void run();
+
+  private:
+    void receive(uInt8 c, uInt64 now);
+    void sendDue(uInt64 now);
+    void reset(uInt64 now);
+
+    uInt8 corrupt(uInt8 c);
+    uInt64 byteMicros(uInt32 baud) const {
+      return myConfig.paced && baud != 0 ? (10'000'000ULL + baud - 1) / baud : 0;
+    }
+    static uInt64 nowMicros();
+
+  private:
+    struct TxByte { uInt64 time; uInt8 c; };
+
+    Config myConfig;
+    LpcIspEmulator myChip;
+
+    int myMaster{-1};
+    int mySlave{-1};   // kept open, so the pty survives the host closing it
+
+    bool myResetPending{false};
+    uInt32 myChipBaud{0};   // baud rate the bootloader locked on to; 0 in autobaud
+    uInt64 myRxFree{0}, myTxFree{0};
+
+    std::deque<TxByte> myTxQueue;
+    std::mt19937 myRandom;
+
+    uInt32 myResets{0};
+    uInt64 myBytesReceived{0}, myBytesSent{0};
+
+  private:
+    // Following constructors and assignment operators not supported
+    FakeCart() = delete;
+    FakeCart(const FakeCart&) = delete;
+    FakeCart(FakeCart&&) = delete;
+    FakeCart& operator=(const FakeCart&) = delete;
+    FakeCart& operator=(FakeCart&&) = delete;
+};
+
+// Set by SIGINT and SIGTERM
+static volatile sig_atomic_t quitRequested = 0;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+FakeCart::FakeCart(const Config& config)
+  : myConfig{config},
+    myChip{config.chip},
+    myRandom{config.seed}
+{
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+FakeCart::~FakeCart()
+{
+  if(mySlave >= 0)
+    close(mySlave);
+  if(myMaster >= 0)
+    close(myMaster);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string FakeCart::open()
+{
+  myMaster = posix_openpt(O_RDWR | O_NOCTTY);
+  if(myMaster < 0 || grantpt(myMaster) != 0 || unlockpt(myMaster) != 0)
+    return "";
+
+  const char* name = ptsname(myMaster);
+  if(name == nullptr)
+    return "";
+  const string slave = name;
+
+  mySlave = ::open(slave.c_str(), O_RDWR | O_NOCTTY);
+  if(mySlave < 0)
+    return "";
+
+  // Until the host sets up the port, nothing may be altered on the way
+  struct termios tio;
+  tcgetattr(mySlave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(mySlave, TCSANOW, &tio);
+
+  int packet = 1;
+  if(ioctl(myMaster, TIOCPKT, &packet) != 0)
+    return "";
+
+  return slave;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FakeCart::run()
+{
+  uInt8 buf[1024];
+
+  while(!quitRequested)
+  {
+    uInt64 now = nowMicros();
+    sendDue(now);
+
+    // Sleep until the next byte is due to be sent, or the host sends more
+    struct timespec wait{0, 0}, *timeout = nullptr;
+    if(!myTxQueue.empty())
+    {
+      const uInt64 delay = myTxQueue.front().time - std::min(now, myTxQueue.front().time);
+      wait.tv_sec = static_cast<time_t>(delay / 1000000);
+      wait.tv_nsec = static_cast<long>(delay % 1000000) * 1000;
+      timeout = &wait;
+    }
+    struct pollfd pfd{myMaster, POLLIN, 0};
+    const int rc = ppoll(&pfd, 1, timeout, nullptr);
+    if(rc < 0 && errno != EINTR)
+      break;
+    if(rc <= 0 || !(pfd.revents & POLLIN))
+      continue;
+
+    // In packet mode, each read returns either data or a status change
+    const ssize_t size = read(myMaster, buf, sizeof(buf));
+    if(size <= 0)
+      continue;
+
+    now = nowMicros();
+    if(buf[0] != TIOCPKT_DATA)
+    {
+      if(buf[0] & (TIOCPKT_FLUSHREAD | TIOCPKT_FLUSHWRITE))
+        myResetPending = true;
+    }
+    else
+      for(ssize_t i = 1; i < size; ++i)
+        receive(buf[i], now);
+  }
+
+  cout << "\n" << myResets << " resets, " << myBytesReceived << " bytes received, "
+       << myBytesSent << " bytes sent, " << myChip.eraseCount() << " erases, "
+       << myChip.copyCount() << " copies\n";
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FakeCart::receive(uInt8 c, uInt64 now)
+{
+  if(myResetPending)
+  {
+    myResetPending = false;
+    if(c == '?')
+      reset(now);
+  }
+  ++myBytesReceived;
+
+  const uInt32 baud = Termios2::getBaud(mySlave);
+  myRxFree = std::max(now, myRxFree) + byteMicros(baud);
+  const uInt64 arrival = myRxFree + myConfig.latencyMicros;
+
+  // The bootloader locks on to whatever rate the autobaud '?' is sent at;
+  // after that, anything sent at a different rate arrives as garbage
+  c = corrupt(c);
+  if(myChipBaud == 0 && c == '?')
+    myChipBaud = baud;
+  else if(myChipBaud != 0 && myChipBaud != baud)
+    c = static_cast<uInt8>(myRandom());
+
+  string out;
+  const uInt32 busy = myChip.receive(c, out);
+
+  const uInt64 chipByte = byteMicros(myChipBaud ? myChipBaud : baud);
+  myTxFree = std::max(arrival + busy, myTxFree);
+  for(auto ch: out)
+  {
+    myTxFree += chipByte;
+    uInt8 r = corrupt(static_cast<uInt8>(ch));
+    if(myChipBaud != baud)
+      r = static_cast<uInt8>(myRandom());
+    myTxQueue.push_back({ myTxFree + myConfig.latencyMicros, r });
+  }
+
+  // A baud rate change takes effect once its answer has been sent
+  if(myChip.requestedBaud() != 0 && myChip.requestedBaud() != myChipBaud)
+  {
+    myChipBaud = myChip.requestedBaud();
+    if(myConfig.verbose)
+      cout << "Switched to " << myChipBaud << " baud\n" << std::flush;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FakeCart::sendDue(uInt64 now)
+{
+  uInt8 buf[1024];
+  size_t size = 0;
+  while(size < sizeof(buf) && !myTxQueue.empty() && myTxQueue.front().time <= now)
+  {
+    buf[size++] = myTxQueue.front().c;
+    myTxQueue.pop_front();
+  }
+
+  // Whatever the host doesn't pick up is lost, as on a real line
+  if(size > 0 && write(myMaster, buf, size) > 0)
+    myBytesSent += size;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FakeCart::reset(uInt64 now)
+{
+  myChip.reset();
+  myChipBaud = 0;
+  myTxQueue.clear();
+  myRxFree = myTxFree = now;
+  ++myResets;
+
+  if(myConfig.verbose)
+    cout << "Reset\n" << std::flush;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt8 FakeCart::corrupt(uInt8 c)
+{
+  if(myConfig.bitErrorRate > 0.0)
+  {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    for(int bit = 0; bit < 8; ++bit)
+      if(dist(myRandom) < myConfig.bitErrorRate)
+        c ^= (1 << bit);
+  }
+  return c;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt64 FakeCart::nowMicros()
+{
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void usage()
+{
+  cout << "Usage: fakecart [options ...]\n"
+       << "       Answers as a Harmony cart on a pseudo-terminal, whose name is\n"
+       << "       printed on startup; use it with 'harmonycart -port=<name>'\n"
+       << '\n'
+       << "Valid options are:\n"
+       << '\n'
+       << "  -part=name  LPC part to emulate (default is '2103')\n"
+       << "  -ber=n      Probability of each bit being flipped (default is 0)\n"
+       << "  -latency=n  Additional one-way latency, in microseconds (default is 0)\n"
+       << "  -seed=n     Seed for the bit errors (default is 1)\n"
+       << "  -link=path  Also make the pseudo-terminal available as 'path'\n"
+       << "  -nopace     Don't take the time a real serial link would to send data\n"
+       << "  -verbose    Report resets and baud rate changes\n"
+       << "  -help       Displays the message you're now reading\n"
+       << '\n';
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int main(int ac, char* av[])
+{
+  FakeCart::Config config;
+  string part = "2103";
+  string link = "";
+
+  for(int i = 1; i < ac; ++i)
+  {
+    if(BSPF::startsWithIgnoreCase(av[i], "-part="))
+      part = av[i]+6;
+    else if(BSPF::startsWithIgnoreCase(av[i], "-ber="))
+      config.bitErrorRate = atof(av[i]+5);
+    else if(BSPF::startsWithIgnoreCase(av[i], "-latency="))
+      config.latencyMicros = static_cast<uInt32>(atoi(av[i]+9));
+    else if(BSPF::startsWithIgnoreCase(av[i], "-seed="))
+      config.seed = static_cast<uInt32>(atoi(av[i]+6));
+    else if(BSPF::startsWithIgnoreCase(av[i], "-link="))
+      link = av[i]+6;
+    else if(BSPF::equalsIgnoreCase(av[i], "-nopace"))
+      config.paced = false;
+    else if(BSPF::equalsIgnoreCase(av[i], "-verbose"))
+      config.verbose = true;
+    else
+    {
+      if(!BSPF::equalsIgnoreCase(av[i], "-help"))
+        cout << "Unknown argument \'" << av[i] << "\'\n\n";
+      usage();
+      return 1;
+    }
+  }
+
+  if(!config.chip.setPart(part))
+  {
+    cout << "Unknown LPC part \'" << part << "\'\n";
+    return 1;
+  }
+
+  FakeCart cart(config);
+  const string slave = cart.open();
+  if(slave == "")
+  {
+    cout << "Couldn't create pseudo-terminal\n";
+    return 1;
+  }
+  if(link != "")
+  {
+    unlink(link.c_str());
+    if(symlink(slave.c_str(), link.c_str()) != 0)
+    {
+      cout << "Couldn't create \'" << link << "\'\n";
+      return 1;
+    }
+  }
+
+  signal(SIGINT, [](int) { quitRequested = 1; });
+  signal(SIGTERM, [](int) { quitRequested = 1; });
+
+  cout << slave << '\n' << std::flush;
+  cart.run();
+
+  if(link != "")
+    unlink(link.c_str());
+
+  return 0;
+}
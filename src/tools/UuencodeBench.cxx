@@ -0,0 +1,170 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include <chrono>
+#include <random>
+
+#include "bspf.hxx"
+#include "Uuencode.hxx"
+
+/*
+  Measures the throughput of the Uuencode line encoder and decoder, and
+  compares the encoder with the per-character loop it replaced (which is
+  also used to check that both give the same lines and checksums).
+*/
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void usage()
+{
+  cout << "Usage: uubench [options ...]\n"
+       << "       Measures how fast data lines are uuencoded and decoded\n"
+       << '\n'
+       << "Valid options are:\n"
+       << '\n'
+       << "  -size=KiB   Amount of (random) data to encode per pass (default 512)\n"
+       << "  -passes=n   Number of passes over the data (default 50)\n"
+       << "  -help       Displays the message you're now reading\n"
+       << '\n';
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The encoder as it was before Uuencode, one character at a time
+uInt32 encodeLineReference(const uInt8* data, char* line)
+{
+  static constexpr std::array<char, 64> table = [] {
+    std::array<char, 64> t{};
+    t[0] = 0x60;  // 0x20 is translated to 0x60 !
+    for(int i = 1; i < 64; ++i)
+      t[i] = static_cast<char>(0x20 + i);
+    return t;
+  }();
+
+  uInt32 sum = 0, k = 0, pos = 0;
+  line[pos++] = ' ' + Uuencode::LINE_BYTES;
+  for(uInt32 i = 0; i < Uuencode::LINE_BYTES; ++i)
+  {
+    const uInt8 c = data[i];
+    sum += c;
+    k = (k << 8) + c;
+    if(i % 3 == 2)
+    {
+      line[pos++] = table[(k >> 18) & 63];
+      line[pos++] = table[(k >> 12) & 63];
+      line[pos++] = table[(k >>  6) & 63];
+      line[pos++] = table[ k        & 63];
+    }
+  }
+  line[pos++] = '\r';
+  line[pos++] = '\n';
+  line[pos] = 0;
+
+  return sum;
+}
+
+// Keeps the measured work from being optimized away
+static volatile uInt32 workDone = 0;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Run the given function over every line of the data, the given number of
+// times, and report the throughput in MB/s of (unencoded) data
+template<typename Function>
+double measure(const ByteArray& data, uInt32 passes, Function&& function)
+{
+  uInt32 sink = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for(uInt32 pass = 0; pass < passes; ++pass)
+    for(size_t i = 0; i + Uuencode::LINE_BYTES <= data.size(); i += Uuencode::LINE_BYTES)
+      sink += function(data.data() + i);
+  const auto stop = std::chrono::steady_clock::now();
+  workDone = sink;
+
+  const double seconds = std::chrono::duration<double>(stop - start).count();
+  return seconds > 0 ? data.size() * static_cast<double>(passes) / seconds / 1e6 : 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int main(int ac, char* av[])
+{
+  uInt32 size = 512, passes = 50;
+
+  for(int i = 1; i < ac; ++i)
+  {
+    if(BSPF::startsWithIgnoreCase(av[i], "-size="))
+      size = BSPF::stoi(av[i]+6);
+    else if(BSPF::startsWithIgnoreCase(av[i], "-passes="))
+      passes = BSPF::stoi(av[i]+8);
+    else
+    {
+      if(!BSPF::equalsIgnoreCase(av[i], "-help"))
+        cout << "Unknown argument \'" << av[i] << "\'\n\n";
+      usage();
+      return 1;
+    }
+  }
+  if(size == 0 || passes == 0)
+  {
+    usage();
+    return 1;
+  }
+
+  ByteArray data(size * 1024);
+  std::mt19937 random(1);
+  for(auto& b: data)
+    b = static_cast<uInt8>(random());
+
+  // Both encoders must give the same lines and checksums, and decoding
+  // must give back the data
+  const uInt32 lines = static_cast<uInt32>(data.size() / Uuencode::LINE_BYTES);
+  for(uInt32 i = 0; i < lines; ++i)
+  {
+    const uInt8* in = data.data() + i * Uuencode::LINE_BYTES;
+    char line[Uuencode::LINE_SIZE], expected[Uuencode::LINE_SIZE];
+    uInt8 decoded[Uuencode::LINE_BYTES];
+    uInt32 sum = 0;
+    if(Uuencode::encodeLine(in, line) != encodeLineReference(in, expected) ||
+       strcmp(line, expected) != 0 ||
+       Uuencode::decodeLine(line, decoded, sum) != Uuencode::LINE_BYTES ||
+       memcmp(decoded, in, Uuencode::LINE_BYTES) != 0)
+    {
+      cerr << "Line " << i << " isn't encoded correctly\n";
+      return 1;
+    }
+  }
+
+  std::vector<std::array<char, Uuencode::LINE_SIZE>> encoded(lines);
+  for(uInt32 i = 0; i < lines; ++i)
+    Uuencode::encodeLine(data.data() + i * Uuencode::LINE_BYTES, encoded[i].data());
+
+  char line[Uuencode::LINE_SIZE];
+  const double reference = measure(data, passes,
+      [&](const uInt8* in) { return encodeLineReference(in, line) + line[1]; });
+  const double encode = measure(data, passes,
+      [&](const uInt8* in) { return Uuencode::encodeLine(in, line) + line[1]; });
+
+  uInt8 decoded[Uuencode::LINE_BYTES];
+  const double decode = measure(data, passes, [&](const uInt8* in) {
+    uInt32 sum = 0;
+    const size_t i = (in - data.data()) / Uuencode::LINE_BYTES;
+    return Uuencode::decodeLine(encoded[i].data(), decoded, sum) + sum;
+  });
+
+  cout << lines << " lines of " << Uuencode::LINE_BYTES << " bytes, "
+       << passes << " passes\n"
+       << std::fixed << std::setprecision(1)
+       << "Encode (per character):  " << std::setw(8) << reference << " MB/s\n"
+       << "Encode (Uuencode):       " << std::setw(8) << encode << " MB/s\n"
+       << "Decode (Uuencode):       " << std::setw(8) << decode << " MB/s\n";
+
+  return 0;
+}
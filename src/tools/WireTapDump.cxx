@@ -0,0 +1,242 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#include "bspf.hxx"
+#include "WireTap.hxx"
+
+/*
+  Converts a capture made with 'harmonycart -capture=file' to text or CSV,
+  and sums up where the time of the session went.
+*/
+
+using Record = WireTap::Record;
+using Event = WireTap::Event;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void usage()
+{
+  cout << "Usage: wiretap [options ...] capturefile\n"
+       << "       Shows the contents of a capture made with 'harmonycart -capture'\n"
+       << '\n'
+       << "Valid options are:\n"
+       << '\n'
+       << "  -csv        Write the records as comma-separated values instead\n"
+       << "  -summary    Only show the summary of the session\n"
+       << "  -help       Displays the message you're now reading\n"
+       << '\n';
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string escape(const string& data, bool csv)
+{
+  ostringstream out;
+  for(auto c: data)
+  {
+    switch(c)
+    {
+      case '\r':  out << "\\r";  break;
+      case '\n':  out << "\\n";  break;
+      case '\\':  out << "\\\\"; break;
+      case '"':   out << (csv ? "\"\"" : "\""); break;
+      default:
+        if(c >= 32 && c < 127)
+          out << c;
+        else
+          out << "\\x" << std::hex << std::setw(2) << std::setfill('0')
+              << static_cast<int>(static_cast<uInt8>(c)) << std::dec;
+    }
+  }
+  return out.str();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void dumpText(const std::vector<Record>& records)
+{
+  cout << "    time (ms)     gap (ms)  event     size  data\n";
+
+  uInt64 last = 0;
+  for(const auto& r: records)
+  {
+    cout << std::fixed << std::setprecision(3)
+         << std::setw(13) << r.micros / 1000.0 << "  "
+         << std::setw(11) << (r.micros - last) / 1000.0 << "  "
+         << std::left << std::setw(8) << WireTap::eventName(r.event) << std::right
+         << std::setw(6) << r.data.size() << "  " << escape(r.data, false) << '\n';
+    last = r.micros;
+  }
+  cout << '\n';
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void dumpCSV(const std::vector<Record>& records)
+{
+  cout << "time_us,gap_us,event,size,data\n";
+
+  uInt64 last = 0;
+  for(const auto& r: records)
+  {
+    cout << r.micros << ',' << (r.micros - last) << ',' << WireTap::eventName(r.event)
+         << ',' << r.data.size() << ",\"" << escape(r.data, true) << "\"\n";
+    last = r.micros;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void summarize(const std::vector<Record>& records)
+{
+  uInt64 sent = 0, received = 0;
+  uInt32 sends = 0, resets = 0, flushes = 0;
+  string bauds, answers;
+
+  // Time from a write to the first data read after it
+  uInt64 lastSend = 0, latencyTotal = 0, latencyMax = 0;
+  uInt32 latencies = 0;
+  bool waiting = false;
+
+  // The longest gaps between records, as (gap, index of the record after it)
+  std::vector<std::pair<uInt64, size_t>> gaps;
+
+  for(size_t i = 0; i < records.size(); ++i)
+  {
+    const Record& r = records[i];
+    switch(r.event)
+    {
+      case Event::Send:
+        sent += r.data.size();
+        ++sends;
+        lastSend = r.micros;
+        waiting = true;
+        break;
+
+      case Event::Receive:
+        received += r.data.size();
+        answers += r.data;
+        if(waiting)
+        {
+          const uInt64 latency = r.micros - lastSend;
+          latencyTotal += latency;
+          latencyMax = std::max(latencyMax, latency);
+          ++latencies;
+          waiting = false;
+        }
+        break;
+
+      case Event::Flush:
+        ++flushes;
+        break;
+
+      case Event::Baud:
+        bauds += (bauds.empty() ? "" : " -> ") + r.data;
+        break;
+
+      case Event::ModemLines:
+        // CartProgrammer::reset() asserts both lines
+        if(r.data == "11")
+          ++resets;
+        break;
+
+      default:
+        break;
+    }
+    if(i > 0)
+      gaps.emplace_back(r.micros - records[i-1].micros, i);
+  }
+
+  // The bootloader answers "RESEND" to a window with a bad checksum
+  uInt32 resends = 0;
+  for(size_t pos = answers.find("RESEND"); pos != string::npos;
+      pos = answers.find("RESEND", pos + 1))
+    ++resends;
+
+  const double seconds = records.empty() ? 0.0 : records.back().micros / 1000000.0;
+  cout << std::fixed << std::setprecision(3)
+       << "Session length:    " << seconds << " seconds\n"
+       << "Data sent:         " << sent << " bytes in " << sends << " writes\n"
+       << "Data received:     " << received << " bytes\n"
+       << "Resets:            " << resets << '\n'
+       << "Buffer flushes:    " << flushes << '\n'
+       << "Baud rates:        " << (bauds.empty() ? "-" : bauds) << '\n'
+       << "Windows resent:    " << resends << '\n';
+  if(latencies > 0)
+    cout << "Answer latency:    " << latencyTotal / 1000.0 / latencies << " ms average, "
+         << latencyMax / 1000.0 << " ms maximum (" << latencies << " answers)\n";
+
+  // Show where most of the time went
+  const size_t shown = std::min<size_t>(gaps.size(), 5);
+  std::partial_sort(gaps.begin(), gaps.begin() + shown, gaps.end(),
+      [](const auto& a, const auto& b) { return a.first > b.first; });
+  if(shown > 0)
+    cout << "Longest gaps:\n";
+  for(size_t i = 0; i < shown; ++i)
+  {
+    const Record& before = records[gaps[i].second - 1];
+    const Record& after = records[gaps[i].second];
+    cout << std::setw(13) << gaps[i].first / 1000.0 << " ms at "
+         << before.micros / 1000.0 << " ms, "
+         << WireTap::eventName(before.event) << " \"" << escape(before.data.substr(0, 16), false)
+         << "\" -> " << WireTap::eventName(after.event) << " \""
+         << escape(after.data.substr(0, 16), false) << "\"\n";
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int main(int ac, char* av[])
+{
+  bool csv = false, summary = false;
+  string capturefile = "";
+
+  for(int i = 1; i < ac; ++i)
+  {
+    if(BSPF::equalsIgnoreCase(av[i], "-csv"))
+      csv = true;
+    else if(BSPF::equalsIgnoreCase(av[i], "-summary"))
+      summary = true;
+    else if(BSPF::startsWithIgnoreCase(av[i], "-"))
+    {
+      if(!BSPF::equalsIgnoreCase(av[i], "-help"))
+        cout << "Unknown argument \'" << av[i] << "\'\n\n";
+      usage();
+      return 1;
+    }
+    else
+      capturefile = av[i];
+  }
+  if(capturefile == "")
+  {
+    usage();
+    return 1;
+  }
+
+  std::vector<Record> records;
+  if(!WireTap::load(capturefile, records))
+  {
+    cerr << "\'" << capturefile << "\' isn't a capture, or is damaged";
+    if(records.empty())
+    {
+      cerr << '\n';
+      return 1;
+    }
+    cerr << "; showing the first " << records.size() << " records\n";
+  }
+
+  if(csv)
+    dumpCSV(records);
+  else
+  {
+    if(!summary)
+      dumpText(records);
+    summarize(records);
+  }
+  return 0;
+}
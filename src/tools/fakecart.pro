@@ -0,0 +1,21 @@
+# Stand-in for a Harmony cart on a pseudo-terminal (Linux only); see
+# src/tools/FakeCart.cxx.  The device table and the emulated bootloader
+# are shared with the main program.
+TARGET = fakecart
+TEMPLATE = app
+
+CONFIG += c++20 console
+CONFIG -= app_bundle
+
+SOURCES += FakeCart.cxx \
+    ../common/CartProgrammer.cxx \
+    ../common/FlashCache.cxx \
+    ../common/LpcIspEmulator.cxx \
+    ../common/TransferPlan.cxx \
+    ../common/Uuencode.cxx \
+    ../unix/Termios2.cxx
+
+DEFINES += BSPF_UNIX
+INCLUDEPATH += ../common ../unix
+QT += widgets
+OBJECTS_DIR = obj
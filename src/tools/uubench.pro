@@ -0,0 +1,13 @@
+# Measures the throughput of the uuencoding of data lines; see
+# src/tools/UuencodeBench.cxx
+TARGET = uubench
+TEMPLATE = app
+
+CONFIG += c++20 console release
+CONFIG -= app_bundle qt
+
+SOURCES += UuencodeBench.cxx \
+    ../common/Uuencode.cxx
+
+INCLUDEPATH += ../common
+OBJECTS_DIR = obj
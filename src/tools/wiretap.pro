@@ -0,0 +1,13 @@
+# Converts serial I/O captures (made with 'harmonycart -capture=file') to
+# text or CSV; see src/tools/WireTapDump.cxx
+TARGET = wiretap
+TEMPLATE = app
+
+CONFIG += c++20 console
+CONFIG -= app_bundle qt
+
+SOURCES += WireTapDump.cxx \
+    ../common/WireTap.cxx
+
+INCLUDEPATH += ../common
+OBJECTS_DIR = obj
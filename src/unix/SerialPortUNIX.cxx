@@ -18,24 +18,39 @@
   #include <sys/errno.h>
 #endif
 
+#if defined(__linux__)
+  #include <linux/serial.h>
+#endif
+
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <fstream>
+#include <dirent.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/param.h>
 #include <sys/termios.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "FSNode.hxx"
 #include "SerialPortUNIX.hxx"
+#include "Termios2.hxx"
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 SerialPortUNIX::SerialPortUNIX()
   : SerialPort()
 {
+  // Lets port enumeration and the low latency setting be tried against a
+  // fake directory tree, without touching the real devices
+  if(const char* root = std::getenv("HARMONYCART_SYSFS"); root && *root)
+    mySysfsRoot = root;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -61,38 +76,21 @@ bool SerialPortUNIX::openPort(const string& device)
   myNewtio = myOldtio;
   myNewtio.c_cflag = CS8 | CLOCAL | CREAD;
 
-#if defined(__FreeBSD__) || defined(__OpenBSD__)
-  if(cfsetspeed(&myNewtio, (speed_t)myBaud)
+  // Rates without a Bxxxx constant are set through termios2 once all other
+  // settings are in place; until then the port runs at a standard rate
+  bool customBaud = false;
+  if(!setTermiosBaud(myNewtio, myBaud))
   {
-    cerr << "ERROR: baudrate " << myBaud << " not supported" << endl;
-    return false;
-  }
-#else
-  #define NEWTERMIOS_SETBAUDRATE(bps) myNewtio.c_cflag |= bps;
-
-  switch (myBaud)
-  {
-#if defined (B1152000)
-    case 1152000: NEWTERMIOS_SETBAUDRATE(B1152000); break;
+#if defined(__linux__)
+    customBaud = setTermiosBaud(myNewtio, 38400);
 #endif
-#if defined (B576000)
-    case  576000: NEWTERMIOS_SETBAUDRATE(B576000);  break;
-#endif
-#if defined (B230400)
-    case  230400: NEWTERMIOS_SETBAUDRATE(B230400);  break;
-#endif
-    case  115200: NEWTERMIOS_SETBAUDRATE(B115200);  break;
-    case   57600: NEWTERMIOS_SETBAUDRATE(B57600);   break;
-    case   38400: NEWTERMIOS_SETBAUDRATE(B38400);   break;
-    case   19200: NEWTERMIOS_SETBAUDRATE(B19200);   break;
-    case    9600: NEWTERMIOS_SETBAUDRATE(B9600);    break;
-    default:
+    if(!customBaud)
     {
       cerr << "ERROR: unknown baudrate " << myBaud << '\n';
+      closePort();
       return false;
     }
   }
-#endif
 
   myNewtio.c_iflag = IGNPAR | IGNBRK | IXON | IXOFF;
   myNewtio.c_oflag = 0;
@@ -101,16 +99,28 @@ bool SerialPortUNIX::openPort(const string& device)
   myNewtio.c_lflag = 0;
 
   cfmakeraw(&myNewtio);
-  myNewtio.c_cc[VTIME] = 1;   /* inter-character timer used */
-  myNewtio.c_cc[VMIN]  = 0;   /* blocking read until 0 chars received */
+  myNewtio.c_cc[VTIME] = 0;   /* no inter-character timer; poll() does the waiting */
+  myNewtio.c_cc[VMIN]  = 0;   /* read returns whatever is already there */
 
   tcflush(myHandle, TCIFLUSH);
   if(tcsetattr(myHandle, TCSANOW, &myNewtio))
   {
     cerr << "Could not change serial port behaviour for "
          << device << " (tcsetattr failed)\n";
+    closePort();
     return false;
   }
+#if defined(__linux__)
+  if(customBaud && !Termios2::setBaud(myHandle, myBaud, false))
+  {
+    cerr << "ERROR: baudrate " << myBaud << " not supported by " << device << '\n';
+    closePort();
+    return false;
+  }
+#endif
+
+  if(myLowLatency)
+    enableLowLatency(device);
 
   return true;
 }
@@ -120,6 +130,8 @@ void SerialPortUNIX::closePort()
 {
   if(isOpen())
   {
+    restoreLatency();
+
     tcflush(myHandle, TCOFLUSH);
     tcflush(myHandle, TCIFLUSH);
     tcsetattr(myHandle, TCSANOW, &myOldtio);
@@ -138,39 +150,32 @@ bool SerialPortUNIX::isOpen()
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 size_t SerialPortUNIX::receiveBlock(void* answer, size_t max_size)
 {
-  size_t result = 0;
-  if(isOpen())
+  if(!isOpen())
+    return 0;
+
+  // Wait until something arrives or the deadline passes, whichever is first
+  struct pollfd pfd = { myHandle, POLLIN, 0 };
+  int ready = 0;
+  do
   {
-    result = read(myHandle, answer, max_size);
-    if(result == 0)
-      timeoutTick();
-  }
-  return result;
-#if 0
-// FIXME: from lpc21isp 1.93 (not sure if this will be used yet)
-// This replaces the read call above
-    {
-        fd_set
-            readSet;
-        struct timeval
-            timeVal;
-
-        FD_ZERO(&readSet);                             // clear the set
-        FD_SET(IspEnvironment->fdCom,&readSet);        // add this descriptor to the set
-        timeVal.tv_sec=0;                              // set up the timeout waiting for one to come ready (500ms)
-        timeVal.tv_usec=500*1000;
-        if(select(FD_SETSIZE,&readSet,NULL,NULL,&timeVal)==1)    // wait up to 500 ms or until our data is ready
-        {
-            *real_size=read(IspEnvironment->fdCom, answer, max_size);
-        }
-        else
-        {
-            // timed out, show no characters received and timer expired
-            *real_size=0;
-            IspEnvironment->serial_timeout_count=0;
-        }
-    }
+    const uInt64 now = monotonicNanos();
+    const uInt64 remaining = myDeadline > now ? myDeadline - now : 0;
+#if defined(BSPF_MACOS)
+    ready = poll(&pfd, 1, static_cast<int>((remaining + 999'999) / 1'000'000));
+#else
+    const struct timespec wait = {
+      static_cast<time_t>(remaining / 1'000'000'000),
+      static_cast<long>(remaining % 1'000'000'000)
+    };
+    ready = ppoll(&pfd, 1, &wait, nullptr);
 #endif
+  } while(ready < 0 && errno == EINTR);
+
+  if(ready <= 0)
+    return 0;
+
+  const ssize_t result = read(myHandle, answer, max_size);
+  return result > 0 ? static_cast<size_t>(result) : 0;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -179,20 +184,55 @@ size_t SerialPortUNIX::sendBlock(const void* data, size_t size)
   return isOpen() ? write(myHandle, data, size) : 0;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+size_t SerialPortUNIX::sendBlocks(std::span<const std::string_view> blocks)
+{
+  if(!isOpen())
+    return 0;
+
+  // Enough for a window of data lines and its checksum in one call
+#if defined(IOV_MAX)
+  static constexpr size_t MAX_BLOCKS = std::min<size_t>(IOV_MAX, 32);
+#else
+  static constexpr size_t MAX_BLOCKS = 16;
+#endif
+  struct iovec iov[MAX_BLOCKS];
+  size_t result = 0;
+
+  for(size_t first = 0; first < blocks.size(); first += MAX_BLOCKS)
+  {
+    const size_t count = std::min(MAX_BLOCKS, blocks.size() - first);
+    size_t size = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+      iov[i].iov_base = const_cast<char*>(blocks[first + i].data());
+      iov[i].iov_len  = blocks[first + i].size();
+      size += iov[i].iov_len;
+    }
+
+    const ssize_t written = writev(myHandle, iov, static_cast<int>(count));
+    if(written > 0)
+      result += written;
+    if(written != static_cast<ssize_t>(size))
+      break;
+  }
+  return result;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void SerialPortUNIX::setTimeout(uInt32 timeout_milliseconds)
 {
-  mySerialTimeoutCount = timeout_milliseconds / 100;
+  myDeadline = monotonicNanos() + timeout_milliseconds * 1'000'000ULL;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool SerialPortUNIX::timeoutCheck()
 {
-  return mySerialTimeoutCount == 0;
+  return monotonicNanos() >= myDeadline;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void SerialPortUNIX::clearBuffers()
+void SerialPortUNIX::flushBuffers()
 {
   // Variables to store the current tty state, create a new one
   struct termios origtty, tty;
@@ -249,6 +289,141 @@ void SerialPortUNIX::controlXonXoff(bool XonXoff)
   tcsetattr(myHandle, TCSANOW, &myNewtio);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortUNIX::changeBaud(uInt32 baud)
+{
+  if(!isOpen())
+    return false;
+
+  // Let any pending output go out at the old rate first
+  struct termios tio = myNewtio;
+  if(setTermiosBaud(tio, baud))
+  {
+    if(tcsetattr(myHandle, TCSADRAIN, &tio))
+      return false;
+    myNewtio = tio;
+  }
+#if defined(__linux__)
+  else if(!Termios2::setBaud(myHandle, baud, true))
+    return false;
+#else
+  else
+    return false;
+#endif
+
+  myBaud = baud;
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 SerialPortUNIX::actualBaud()
+{
+#if defined(__linux__)
+  if(isOpen())
+    if(uInt32 baud = Termios2::getBaud(myHandle); baud != 0)
+      return baud;
+#endif
+  return myBaud;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortUNIX::setTermiosBaud(struct termios& tio, uInt32 baud)
+{
+#if defined(__FreeBSD__) || defined(__OpenBSD__)
+  return cfsetspeed(&tio, (speed_t)baud) == 0;
+#else
+  speed_t speed = 0;
+  switch (baud)
+  {
+#if defined (B1152000)
+    case 1152000: speed = B1152000; break;
+#endif
+#if defined (B576000)
+    case  576000: speed = B576000;  break;
+#endif
+#if defined (B230400)
+    case  230400: speed = B230400;  break;
+#endif
+    case  115200: speed = B115200;  break;
+    case   57600: speed = B57600;   break;
+    case   38400: speed = B38400;   break;
+    case   19200: speed = B19200;   break;
+    case    9600: speed = B9600;    break;
+    default:      return false;
+  }
+  return cfsetispeed(&tio, speed) == 0 && cfsetospeed(&tio, speed) == 0;
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortUNIX::enableLowLatency(const string& device)
+{
+#if defined(__linux__)
+  struct serial_struct serial;
+  if(ioctl(myHandle, TIOCGSERIAL, &serial) == 0 && !(serial.flags & ASYNC_LOW_LATENCY))
+  {
+    const int flags = serial.flags;
+    serial.flags |= ASYNC_LOW_LATENCY;
+    if(ioctl(myHandle, TIOCSSERIAL, &serial) == 0)
+      myOldSerialFlags = flags;
+  }
+
+  // USB serial adapters (FTDI and friends) also hold back received data
+  // for up to 'latency_timer' milliseconds (16 by default); 1 is the minimum
+  char path[PATH_MAX];
+  if(realpath(device.c_str(), path) == nullptr)
+    return;
+  const char* name = strrchr(path, '/');
+  const string file = mySysfsRoot + "/class/tty/" + (name ? name + 1 : path) +
+                      "/device/latency_timer";
+
+  string timer;
+  std::ifstream in(file);
+  if(!(in >> timer) || timer == "1")
+    return;
+  in.close();
+
+  // Usually only writable by root, unless a udev rule says otherwise
+  std::ofstream out(file);
+  if(out << "1" << std::flush)
+  {
+    myLatencyTimerFile = file;
+    myOldLatencyTimer = timer;
+  }
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SerialPortUNIX::restoreLatency()
+{
+#if defined(__linux__)
+  if(myOldSerialFlags != -1)
+  {
+    struct serial_struct serial;
+    if(ioctl(myHandle, TIOCGSERIAL, &serial) == 0)
+    {
+      serial.flags = myOldSerialFlags;
+      ioctl(myHandle, TIOCSSERIAL, &serial);
+    }
+    myOldSerialFlags = -1;
+  }
+  if(!myLatencyTimerFile.empty())
+  {
+    std::ofstream out(myLatencyTimerFile);
+    out << myOldLatencyTimer;
+    myLatencyTimerFile.clear();
+  }
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt64 SerialPortUNIX::monotonicNanos()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uInt64>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void SerialPortUNIX::sleepMillis(uInt32 milliseconds)
 {
@@ -260,6 +435,41 @@ const StringList& SerialPortUNIX::getPortNames()
 {
   myPortNames.clear();
 
+#if defined(__linux__)
+  // Every tty backed by hardware has a 'device' link in sysfs (virtual
+  // consoles and ptys don't), so the ports can be found without opening
+  // any of them.  Legacy serial ports that are configured but have no
+  // UART behind them report a type of 0 (PORT_UNKNOWN).
+  myPortInfo.clear();
+  const string ttys = mySysfsRoot + "/class/tty/";
+  DIR* dir = opendir(ttys.c_str());
+  if(dir == nullptr)
+    return myPortNames;
+
+  while(const struct dirent* entry = readdir(dir))
+  {
+    const string name = entry->d_name;
+    const bool legacy = BSPF::startsWithIgnoreCase(name, "ttyS");
+    if(!legacy && !BSPF::startsWithIgnoreCase(name, "ttyUSB"))
+      continue;
+
+    struct stat st;
+    if(stat((ttys + name + "/device").c_str(), &st) != 0 ||
+       (legacy && readLine(ttys + name + "/type") == "0"))
+      continue;
+
+    const string device = "/dev/" + name;
+    if(access(device.c_str(), R_OK | W_OK) != 0)
+      continue;
+
+    myPortNames.push_back(device);
+    myPortInfo[device] = readPortInfo(name);
+  }
+  closedir(dir);
+
+  std::sort(myPortNames.begin(), myPortNames.end());
+  return myPortNames;
+#else
   // Check if port is valid; for now that means if it can be opened
   auto isPortValid = [](const string& port) {
     int handle = open(port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
@@ -289,4 +499,63 @@ const StringList& SerialPortUNIX::getPortNames()
       myPortNames.emplace_back(port.getPath());
 
   return myPortNames;
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::optional<SerialPort::PortInfo> SerialPortUNIX::portInfo(const string& device)
+{
+#if defined(__linux__)
+  const auto it = myPortInfo.find(device);
+  if(it != myPortInfo.end())
+    return it->second;
+
+  // Not found by getPortNames (e.g. a port given by the user, under another
+  // name); sysfs knows it by the name of the actual device node
+  char path[PATH_MAX];
+  if(realpath(device.c_str(), path) == nullptr)
+    return PortInfo();
+  const char* name = strrchr(path, '/');
+
+  return myPortInfo[device] = readPortInfo(name ? name + 1 : path);
+#else
+  return {};
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+SerialPort::PortInfo SerialPortUNIX::readPortInfo(const string& name) const
+{
+  PortInfo info;
+
+  // The tty belongs to a USB interface, which belongs to the USB device
+  // that has the IDs; stop at the first directory that has them
+  char path[PATH_MAX];
+  if(realpath((mySysfsRoot + "/class/tty/" + name + "/device").c_str(), path) == nullptr)
+    return info;
+
+  string dir = path;
+  for(int level = 0; level < 4 && dir.length() > mySysfsRoot.length(); ++level)
+  {
+    const string vendor = readLine(dir + "/idVendor");
+    if(vendor != "")
+    {
+      info.vendorID = static_cast<uInt16>(strtoul(vendor.c_str(), nullptr, 16));
+      info.productID = static_cast<uInt16>(strtoul(readLine(dir + "/idProduct").c_str(), nullptr, 16));
+      info.serialNumber = readLine(dir + "/serial");
+      info.description = readLine(dir + "/product");
+      break;
+    }
+    dir.erase(dir.rfind('/'));
+  }
+  return info;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+string SerialPortUNIX::readLine(const string& file)
+{
+  string line;
+  std::ifstream in(file);
+  std::getline(in, line);
+  return line;
 }
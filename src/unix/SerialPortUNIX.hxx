@@ -15,6 +15,7 @@
 #ifndef SERIALPORT_UNIX_HXX
 #define SERIALPORT_UNIX_HXX
 
+#include <map>
 #include <termios.h>
 
 #include "SerialPort.hxx"
@@ -51,10 +52,9 @@ class SerialPortUNIX : public SerialPort
     bool isOpen() override;
 
     /**
-      Receives a buffer from the open com port. Returns all the characters
-      ready (waits for up to 'n' milliseconds before accepting that no more
-      characters are ready) or when the buffer is full. 'n' is system dependent,
-      see SerialTimeout routines.
+      Receives a buffer from the open com port.  Waits (using poll) until at
+      least one character is ready or the deadline set by setTimeout has
+      passed, then returns all characters ready, up to the size of the buffer.
 
       @param answer    Buffer to hold the bytes read from the serial port
       @param max_size  The size of buffer pointed to by answer
@@ -72,12 +72,18 @@ class SerialPortUNIX : public SerialPort
     size_t sendBlock(const void* data, size_t size) override;
 
     /**
-      Sets (or resets) the timeout to the timout period requested.  Starts
-      counting to this period.  This timeout support is a little odd in that
-      the timeout specifies the accumulated deadtime waiting to read not the
-      total time waiting to read. They should be close enough to the same for
-      this use. Used by the serial input routines, the actual counting takes
-      place in receiveBlock.
+      Write several blocks of bytes to the serial port, with one writev.
+
+      @param blocks  The blocks to write, in order
+      @return  The number of bytes written
+    */
+    size_t sendBlocks(std::span<const std::string_view> blocks) override;
+
+    /**
+      Sets (or resets) the timeout to the timout period requested.  This
+      sets an absolute deadline on the monotonic clock, so a slow trickle of
+      characters can't stretch the total time waiting to read.  Used by the
+      serial input routines, the actual waiting takes place in receiveBlock.
 
       @param timeout_milliseconds  The time in milliseconds to use for timeout
     */
@@ -91,9 +97,10 @@ class SerialPortUNIX : public SerialPort
     bool timeoutCheck() override;
 
     /**
-      Empty the serial port buffers.  Cleans things to a known state.
+      Empty the buffers of the serial port driver.  Cleans things to a
+      known state.
     */
-    void clearBuffers() override;
+    void flushBuffers() override;
 
     /**
       Controls the modem lines to place the microcontroller into various
@@ -111,22 +118,99 @@ class SerialPortUNIX : public SerialPort
     */
     void controlXonXoff(bool XonXoff) override;
 
+    /**
+      Change the baud rate of an already open port.  Under Linux, any rate
+      can be used; elsewhere, only the standard ones.
+
+      @param baud  The new transfer rate for the port
+      @return  False if the rate isn't supported, else true
+    */
+    bool changeBaud(uInt32 baud) override;
+
+    /**
+      The baud rate the port actually runs at, as reported by the driver.
+    */
+    uInt32 actualBaud() override;
+
     /**
       Sleep the specified amount of time (in milliseconds).
     */
     void sleepMillis(uInt32 milliseconds) override;
 
     /**
-      Get all valid serial ports detected on this system.
+      Get all valid serial ports detected on this system.  Under Linux,
+      these are found in a single pass over sysfs, which also collects
+      their USB IDs and names (see portInfo()).
     */
     const StringList& getPortNames() override;
 
+    /**
+      Get the USB IDs, serial number and product name of the given port
+      from sysfs.  Linux only.
+    */
+    std::optional<PortInfo> portInfo(const string& device) override;
+
+    /**
+      Set the directory sysfs is mounted on (normally '/sys').  Only
+      meant to point the port at a fake directory tree for testing; the
+      HARMONYCART_SYSFS environment variable sets it for the whole program.
+    */
+    void setSysfsRoot(const string& root) { mySysfsRoot = root; }
+
+  private:
+    /**
+      Set the given baud rate in the termios structure.
+
+      @return  False if the rate isn't supported, else true
+    */
+    static bool setTermiosBaud(struct termios& tio, uInt32 baud);
+
+    /**
+      Set the driver's low latency flag, and shorten the latency timer of
+      a USB serial adapter where sysfs exposes one.  The original settings
+      are remembered, and put back by restoreLatency.  Linux only.
+
+      @param device  The name of the (already open) port
+    */
+    void enableLowLatency(const string& device);
+    void restoreLatency();
+
+    /**
+      Read the information sysfs has on the given tty (e.g. 'ttyUSB0'),
+      which for a USB device is kept a few levels above the tty itself.
+    */
+    PortInfo readPortInfo(const string& name) const;
+
+    /**
+      The first line of the given (sysfs) file, or an empty string if
+      it can't be read.
+    */
+    static string readLine(const string& file);
+
+    /**
+      Current time on the monotonic clock, in nanoseconds.
+    */
+    static uInt64 monotonicNanos();
+
   private:
     // File descriptor for serial connection
     int myHandle{-1};
 
     struct termios myOldtio{}, myNewtio{};
 
+    // Deadline for the current read, on the monotonic clock (nanoseconds)
+    uInt64 myDeadline{0};
+
+    // Settings changed by enableLowLatency, restored when the port closes
+    int myOldSerialFlags{-1};
+    string myLatencyTimerFile, myOldLatencyTimer;
+
+    // Where sysfs is mounted
+    string mySysfsRoot{"/sys"};
+
+    // Information on the ports found by getPortNames, by device name
+    std::map<string, PortInfo> myPortInfo;
+
   private:
     // Following constructors and assignment operators not supported
     SerialPortUNIX(const SerialPortUNIX&) = delete;
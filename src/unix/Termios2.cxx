@@ -0,0 +1,43 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#if defined(__linux__)
+
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+#include "Termios2.hxx"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool Termios2::setBaud(int fd, uInt32 baud, bool drain)
+{
+  struct termios2 tio;
+  if(ioctl(fd, TCGETS2, &tio) != 0)
+    return false;
+
+  tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+  tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+  tio.c_ispeed = tio.c_ospeed = baud;
+
+  return ioctl(fd, drain ? TCSETSW2 : TCSETS2, &tio) == 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt32 Termios2::getBaud(int fd)
+{
+  struct termios2 tio;
+  return ioctl(fd, TCGETS2, &tio) == 0 ? tio.c_ospeed : 0;
+}
+
+#endif  // __linux__
@@ -0,0 +1,52 @@
+//=========================================================================
+//
+//  H   H    A    RRRR   M   M   OOO   N   N  Y   Y
+//  H   H   A A   R   R  MM MM  O   O  NN  N   Y Y
+//  HHHHH  AAAAA  RRRR   M M M  O   O  N N N    Y   "Harmony Cart software"
+//  H   H  A   A  R R    M   M  O   O  N  NN    Y
+//  H   H  A   A  R  R   M   M   OOO   N   N    Y
+//
+// Copyright (c) 2009-2026 by Stephen Anthony <sa666666@gmail.com>
+//
+// See the file "License.txt" for information on usage and redistribution
+// of this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//=========================================================================
+
+#ifndef TERMIOS2_HXX
+#define TERMIOS2_HXX
+
+#include "bspf.hxx"
+
+/**
+  Access to the Linux 'termios2' interface, which allows a serial port to
+  run at any integer baud rate (BOTHER) instead of only the fixed Bxxxx
+  rates.  The kernel headers it needs clash with <termios.h>, so it lives
+  in its own translation unit, and is only available under Linux.
+
+  @author  Stephen Anthony
+*/
+namespace Termios2 {
+
+  /**
+    Set the given (input and output) baud rate on an open port, leaving all
+    other settings alone.
+
+    @param fd     File descriptor of the port
+    @param baud   The new transfer rate for the port
+    @param drain  Let any pending output go out at the old rate first
+    @return  False if the rate couldn't be set, else true
+  */
+  bool setBaud(int fd, uInt32 baud, bool drain);
+
+  /**
+    Get the baud rate a port actually runs at.  Drivers report the closest
+    rate their hardware can produce, which may differ from the one set.
+
+    @param fd  File descriptor of the port
+    @return  The output baud rate, or 0 if it can't be determined
+  */
+  uInt32 getBaud(int fd);
+
+} // namespace Termios2
+
+#endif
@@ -153,7 +153,7 @@ bool SerialPortWINDOWS::timeoutCheck()
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void SerialPortWINDOWS::clearBuffers()
+void SerialPortWINDOWS::flushBuffers()
 {
   PurgeComm(myHandle, PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR);
 }
@@ -191,6 +191,25 @@ void SerialPortWINDOWS::controlXonXoff(bool XonXoff)
   SetCommState(myHandle, &dcb);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SerialPortWINDOWS::changeBaud(uInt32 baud)
+{
+  if(!isOpen())
+    return false;
+
+  // Let any pending output go out at the old rate first
+  FlushFileBuffers(myHandle);
+
+  DCB dcb;
+  GetCommState(myHandle, &dcb);
+  dcb.BaudRate = baud;
+  if(SetCommState(myHandle, &dcb) == 0)
+    return false;
+
+  myBaud = baud;
+  return true;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void SerialPortWINDOWS::sleepMillis(uInt32 milliseconds)
 {
@@ -90,9 +90,10 @@ class SerialPortWINDOWS : public SerialPort
     bool timeoutCheck() override;
 
     /**
-      Empty the serial port buffers.  Cleans things to a known state.
+      Empty the buffers of the serial port driver.  Cleans things to a
+      known state.
     */
-    void clearBuffers() override;
+    void flushBuffers() override;
 
     /**
       Controls the modem lines to place the microcontroller into various
@@ -110,6 +111,14 @@ class SerialPortWINDOWS : public SerialPort
     */
     void controlXonXoff(bool XonXoff) override;
 
+    /**
+      Change the baud rate of an already open port.
+
+      @param baud  The new transfer rate for the port
+      @return  False if the rate isn't supported, else true
+    */
+    bool changeBaud(uInt32 baud) override;
+
     /**
       Sleep the specified amount of time (in milliseconds).
     */